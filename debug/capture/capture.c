@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Minimal reader of the capture ring (/dev/leetmouse-capN, see leetmouse_uapi.h). Prints every record as one line, until the mouse goes away.
+// Without a device, it takes the capture device of the virtual mouse of /dev/leetmouse-inject (e.g. of 'replay -k'). See Readme.org.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include "leetmouse_uapi.h"
+
+#define MAX_PATH 256
+
+//Finds the capture device, whose input device is named LEETMOUSE_INJECT_NAME
+static int find_inject_capture(char *path, size_t size)
+{
+    char name[MAX_PATH];
+    glob_t g;
+    FILE *f;
+    size_t i;
+    int found = 0;
+
+    if(glob("/sys/class/misc/leetmouse-cap*/device/name", 0, NULL, &g))
+        return 0;
+    for(i = 0; i < g.gl_pathc && !found; i++){
+        f = fopen(g.gl_pathv[i], "r");
+        if(!f) continue;
+        if(fgets(name, sizeof(name), f)){
+            name[strcspn(name, "\n")] = 0;
+            //.../leetmouse-capN/device/name -> /dev/leetmouse-capN
+            if(!strcmp(name, LEETMOUSE_INJECT_NAME)){
+                *strstr(g.gl_pathv[i], "/device/name") = 0;
+                snprintf(path, size, "/dev/%s", strrchr(g.gl_pathv[i], '/') + 1);
+                found = 1;
+            }
+        }
+        fclose(f);
+    }
+    globfree(&g);
+    return found;
+}
+
+static void print_record(const struct leetmouse_capture_record *r)
+{
+    printf("%llu.%09llu len %2u fields 0x%02x btn 0x%02x x %6d y %6d wheel %3d -> x %6d y %6d wheel %3d%s\n",
+        (unsigned long long) r->time / 1000000000, (unsigned long long) r->time % 1000000000, r->len, r->fields,
+        r->btn, r->x, r->y, r->wheel, r->out_x, r->out_y, r->out_wheel, r->deferred ? " deferred" : "");
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-n records] [/dev/leetmouse-capN]\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    char path[MAX_PATH];
+    struct leetmouse_capture_header *h;
+    struct leetmouse_capture_record *rec;
+    struct pollfd pfd;
+    unsigned long long count = 0, limit = 0;
+    __u64 head, tail;
+    int fd, opt;
+
+    while((opt = getopt(argc, argv, "n:")) != -1){
+        switch(opt){
+        case 'n': limit = strtoull(optarg, NULL, 10); break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if(optind < argc)
+        snprintf(path, sizeof(path), "%s", argv[optind]);
+    else if(!find_inject_capture(path, sizeof(path))){
+        fprintf(stderr, "No virtual mouse found. Open /dev/leetmouse-inject first (e.g. replay -k)\n");
+        return 1;
+    }
+
+    //The reader writes 'tail', so the mapping has to be writable
+    fd = open(path, O_RDWR);
+    if(fd < 0){
+        perror(path);
+        return 1;
+    }
+    h = mmap(NULL, LEETMOUSE_CAPTURE_MMAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(h == MAP_FAILED){
+        perror("mmap");
+        return 1;
+    }
+    if(h->version != LEETMOUSE_CAPTURE_VERSION || h->record_size != sizeof(struct leetmouse_capture_record)){
+        fprintf(stderr, "%s: Capture version %u (record size %u) is not supported\n", path, h->version, h->record_size);
+        return 1;
+    }
+    rec = (void *) h + h->data_offset;
+    tail = h->tail;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    while(!limit || count < limit){
+        head = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+        for(; tail != head && (!limit || count < limit); tail++, count++)
+            print_record(&rec[tail & (h->records - 1)]);
+        __atomic_store_n(&h->tail, tail, __ATOMIC_RELEASE);
+        if(tail != head)
+            continue;
+
+        //Ran empty: Sleep until the next record. POLLHUP means, the mouse is gone
+        fflush(stdout);
+        if(poll(&pfd, 1, -1) < 0 || (pfd.revents & POLLHUP))
+            break;
+    }
+
+    fprintf(stderr, "%s: %llu records, %llu dropped\n", path, count, (unsigned long long) __atomic_load_n(&h->dropped, __ATOMIC_RELAXED));
+    munmap(h, LEETMOUSE_CAPTURE_MMAP_SIZE);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,222 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Checks the acceleration curves of the driver against a double precision reference
+// Runs accelerate() of libleetmouse-core over a sweep of speeds and compares the multiplier it took (accel_state.last_mult) with the curve evaluated by libm.
+// See Readme.org for how to build and run it.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include "shim.h"
+#include "accel.h"
+
+#define SAMPLES 20000
+#define MIN_SPEED 0.01                              // Counts per ms. Slower speeds do not fit into the longest frametime (100 ms)
+#define MAX_SPEED 1000.0
+#define GAIN_STEPS 64                               // Slices of the reference integral for Gain between two samples
+#define ABS_TOL 2e-3                                // A sample fails, if its error exceeds ABS_TOL + REL_TOL * |exact|.
+#define REL_TOL 2e-3                                // The absolute term covers the resolution of Q16.16 near a sensitivity of 0
+
+// Parameters of a curve, as written to the module
+struct curve {
+    const char *name;
+    int mode;
+    double acceleration;
+    double exponent;
+    double midpoint;
+    double output_offset;
+    double smoothness;
+    double cap;
+};
+
+// One curve per mode. Mode 4 (custom curve) has no closed form and is left out
+static const struct curve curves[] = {
+    {"linear",      1, 0.04, 0,   0,  0,   0,   0},
+    {"classic",     2, 0.04, 2,   0,  0,   0,   3},
+    {"motivity",    3, 2,    0,   10, 0,   0,   0},
+    {"power",       5, 0.05, 0.5, 0,  0.5, 0,   0},
+    {"natural",     6, 0.1,  0,   0,  0,   0,   2},
+    {"jump",        7, 2,    0,   15, 0,   0.5, 0},
+    {"synchronous", 8, 1.5,  1,   10, 0,   0.5, 0},
+};
+
+static int gain;
+
+//The sensitivity of the curve at a speed in double precision. Mirrors accel_curve() in accel.c
+static double reference_curve(const struct curve *c, double v)
+{
+    double s = 1, u, t;
+
+    if(v <= 0) return v;
+
+    switch(c->mode){
+    case 1: s = 1 + c->acceleration * v; break;
+    case 2: s = pow(1 + c->acceleration * v, c->exponent); break;
+    case 3: s = c->acceleration / (1 + exp(c->midpoint - v)); break;
+    case 5: s = pow(c->acceleration * v, c->exponent) + c->output_offset; break;
+    case 6: s = c->cap > 0 ? c->cap - (c->cap - 1) * exp(-c->acceleration * v) : 1; break;
+    case 7:
+        if(c->smoothness > 0 && c->midpoint > 0)
+            s = 1 + (c->acceleration - 1) / (1 + exp(-2 * M_PI / (c->midpoint * c->smoothness) * (v - c->midpoint)));
+        else
+            s = v >= c->midpoint ? c->acceleration : 1;
+        break;
+    case 8:
+        if(c->acceleration <= 1 || c->midpoint <= 0) break;
+        u = c->exponent / log(c->acceleration) * log(v / c->midpoint);
+        t = c->smoothness > 0 ? 0.5 / c->smoothness : 16;
+        t = pow(tanh(pow(fabs(u), t)), 1 / t);
+        s = exp(copysign(t, u) * log(c->acceleration));
+        break;
+    }
+
+    if(c->cap > 0 && s > c->cap) s = c->cap;
+    return s;
+}
+
+//Area under the curve between two speeds (Simpson's rule)
+static double reference_area(const struct curve *c, double from, double to)
+{
+    double h = (to - from) / GAIN_STEPS, area = 0;
+    int i;
+
+    for(i = 0; i < GAIN_STEPS; i++)
+        area += (reference_curve(c, from + i * h) + 4 * reference_curve(c, from + (i + 0.5) * h) + reference_curve(c, from + (i + 1) * h)) * h / 6;
+    return area;
+}
+
+static int set(const char *name, const char *fmt, double value)
+{
+    char buf[32];
+    int ret;
+
+    snprintf(buf, sizeof(buf), fmt, value);
+    ret = shim_param_set(name, buf);
+    if(ret)
+        fprintf(stderr, "Cannot set parameter %s to %s (error %d)\n", name, buf, ret);
+    return ret;
+}
+
+static int configure(const struct curve *c, int fixed, int lut)
+{
+    return set("AccelerationMode", "%.0f", c->mode)
+        || set("Gain", "%.0f", gain)
+        || set("FixedPoint", "%.0f", fixed)
+        || set("LutSize", "%.0f", lut)
+        || set("Acceleration", "%g", c->acceleration)
+        || set("Exponent", "%g", c->exponent)
+        || set("Midpoint", "%g", c->midpoint)
+        || set("OutputOffset", "%g", c->output_offset)
+        || set("Smoothness", "%g", c->smoothness)
+        || set("SensitivityCap", "%g", c->cap);
+}
+
+//Sweeps the speeds logarithmically. Each one is made of a delta of 'd' counts over 'ns', which accelerate() takes as the frametime (at least 250 us)
+//Returns the number of samples over the tolerance
+static int check(const struct curve *c, int fixed, int lut)
+{
+    struct accel_state state;
+    double v, speed, prev = 1e-9, area = 0, exact, mult, a, abs_max = 0, rel_max = 0, abs_at = 0, rel_at = 0;
+    int i, x, y, wheel, d, over = 0;
+    s64 ns;
+
+    for(i = 0; i < SAMPLES; i++){
+        v = MIN_SPEED * pow(MAX_SPEED / MIN_SPEED, (double) i / (SAMPLES - 1));
+        d = (int) ceil(v / 4);
+        ns = (s64) (d * 1e6 / v);
+        speed = d * 1e6 / ns;
+
+        accel_init_state(&state);
+        x = d;
+        y = 0;
+        wheel = 0;
+        if(accelerate(&state, ns, &x, &y, &wheel))
+            continue;
+
+        //With Gain, the sensitivity is the average of the curve from 0 to the speed. The sweep only moves up, so the area is summed up along
+        if(gain){
+            area += reference_area(c, prev, speed);
+            prev = speed;
+            exact = area / speed;
+        } else
+            exact = reference_curve(c, speed);
+        mult = (double) state.last_mult / 65536;
+        a = fabs(mult - exact);
+        if(a > ABS_TOL + REL_TOL * fabs(exact))
+            over++;
+        if(a > abs_max){
+            abs_max = a;
+            abs_at = speed;
+        }
+        if(exact != 0 && a / fabs(exact) > rel_max){
+            rel_max = a / fabs(exact);
+            rel_at = speed;
+        }
+    }
+
+    printf("%-12s %-6s %-7s max abs %-11.4g at %-9.4g max rel %-11.4g at %-9.4g %s\n",
+        c->name, fixed ? "fixed" : "float", lut ? "cache" : "direct", abs_max, abs_at, rel_max, rel_at, over ? "FAIL" : "ok");
+    return over;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -g                Check the curves with Gain=1\n"
+        "  -p <name>=<value> Set a module parameter, e.g. -p Precision=0. Can be given multiple times\n",
+        name);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int i;
+    int opt, fixed, ret, failed = 0;
+    char *eq;
+
+    while((opt = getopt(argc, argv, "gp:")) != -1){
+        switch(opt){
+        case 'g': gain = 1; break;
+        case 'p':
+            eq = strchr(optarg, '=');
+            if(!eq){
+                usage(argv[0]);
+                return 1;
+            }
+            *eq = 0;
+            ret = shim_param_set(optarg, eq + 1);
+            if(ret){
+                fprintf(stderr, "Cannot set parameter %s to %s (error %d)\n", optarg, eq + 1, ret);
+                return 1;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    ret = accel_init();
+    if(ret){
+        fprintf(stderr, "accel_init() failed with error %d\n", ret);
+        return 1;
+    }
+    if(set("Offset", "%g", 0) || set("SpeedCap", "%g", 0) || set("ReferenceInterval", "%.0f", 1000))
+        return 1;
+
+    for(i = 0; i < sizeof(curves) / sizeof(curves[0]); i++){
+        for(fixed = 0; fixed <= 1; fixed++){
+            if(configure(&curves[i], fixed, 256))
+                return 1;
+            failed |= check(&curves[i], fixed, 1) > 0;
+            if(configure(&curves[i], fixed, 0))
+                return 1;
+            failed |= check(&curves[i], fixed, 0) > 0;
+        }
+    }
+    if(failed)
+        fprintf(stderr, "Error: The curves exceed the tolerance of %g + %g * |exact|\n", ABS_TOL, REL_TOL);
+    return failed;
+}
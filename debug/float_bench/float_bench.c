@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Reports the error and cost of each precision tier of the math kernels in driver/float.h
+// See Readme.org for how to build and run it.
+
+#include <stdio.h>
+#include <math.h>
+#include <x86intrin.h>                              //__rdtsc
+#include "float.h"
+
+#define SAMPLES 1000000
+
+static const char *tier_names[] = {"fast", "balanced", "exact"};
+
+//Distance of a float result to the exact (double) result in units in the last place
+static double ulps(float result, double exact)
+{
+    float e = (float) exact;
+    double ulp = (double) nextafterf(fabsf(e), INFINITY) - fabsf(e);
+    return fabs(result - exact) / ulp;
+}
+
+struct error {
+    double abs;
+    double rel;
+    double ulp;
+};
+
+static void track(struct error *err, float result, double exact)
+{
+    double a = fabs(result - exact);
+    if(a > err->abs) err->abs = a;
+    if(exact != 0 && a / fabs(exact) > err->rel) err->rel = a / fabs(exact);
+    if(ulps(result, exact) > err->ulp) err->ulp = ulps(result, exact);
+}
+
+//Inputs are spread logarithmically (log2, sqrt, pow) or linearly (exp2) over the ranges leetmouse actually uses
+static float input_log(int i)  { return (float) exp2(-10.0 + 30.0 * i / SAMPLES); }
+static float input_exp(int i)  { return (float) (-20.0 + 40.0 * i / SAMPLES); }
+static float input_base(int i) { return (float) (1.0 + 99.0 * i / SAMPLES); }
+static float input_pow(int i)  { return (float) (3.0 * (i % 1000) / 1000); }
+
+static void report(const char *name, int tier, struct error *err, unsigned long long cycles)
+{
+    printf("%-6s %-9s max abs %-12.4g max rel %-12.4g max ulp %-10.1f %6.2f cycles\n",
+        name, tier_names[tier], err->abs, err->rel, err->ulp, (double) cycles / SAMPLES);
+}
+
+//Measures the error against libm and the cycles per call. The cycle count loop feeds
+//each result into the next input, so the calls cannot overlap or be optimized away.
+#define BENCH(name, tier, input, call, exact)                                       \
+    do {                                                                            \
+        struct error err = {0, 0, 0};                                               \
+        unsigned long long start;                                                   \
+        volatile float sink;                                                        \
+        float f, acc = 0;                                                           \
+        int i;                                                                      \
+        for(i = 0; i < SAMPLES; i++){                                               \
+            float x = input(i);                                                     \
+            f = x;                                                                  \
+            call;                                                                   \
+            track(&err, f, exact);                                                  \
+        }                                                                           \
+        start = __rdtsc();                                                          \
+        for(i = 0; i < SAMPLES; i++){                                               \
+            float x = input(i) + acc * 1e-30f;                                      \
+            f = x;                                                                  \
+            call;                                                                   \
+            acc = f;                                                                \
+        }                                                                           \
+        sink = acc;                                                                 \
+        (void) sink;                                                                \
+        report(name, tier, &err, __rdtsc() - start);                                \
+    } while(0)
+
+int main(void)
+{
+    int tier;
+
+    for(tier = PRECISION_FAST; tier <= PRECISION_EXACT; tier++){
+        BENCH("log2", tier, input_log, F_log2(&f, tier), log2((double) x));
+        BENCH("exp2", tier, input_exp, F_exp2(&f, tier), exp2((double) x));
+        BENCH("sqrt", tier, input_log, F_sqrt(&f, tier), sqrt((double) x));
+        BENCH("pow", tier, input_base, {float p = input_pow(i); F_pow(&f, &p, tier);}, pow((double) x, (double) input_pow(i)));
+        printf("\n");
+    }
+
+    return 0;
+}
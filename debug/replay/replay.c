@@ -0,0 +1,444 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Replays a recorded packet trace through the IRQ path of the driver: extract_mouse_events() -> accelerate()
+// Runs the code of libleetmouse-core, so it measures exactly what ships in leetmouse.ko. See Readme.org for how to build and run it.
+// With -k, the trace is injected into the loaded kernel module instead (/dev/leetmouse-inject).
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <math.h>
+#include "shim.h"
+#include "util.h"
+#include "accel.h"
+#include "leetmouse_uapi.h"
+
+#define MAX_DESCRIPTOR 4096
+#define MAX_LINE 1024
+#define MIN_REPORTS 1000000                         // The benchmark loops over the trace until at least this many reports have been processed
+#define MAX_REPORT 256                              // Longest report kept from the trace
+
+struct report {
+    double t;                                       // Timestamp in seconds. Negative, if the trace has none
+    int len;
+    unsigned char data[MAX_REPORT];
+};
+
+struct trace {
+    struct report *reports;
+    int count;
+    int capacity;
+};
+
+//Parses hex bytes ("0x01, 0x00" or "01 00") into data. Returns the number of bytes found
+static int parse_bytes(const char *line, unsigned char *data, int max, int *dropped)
+{
+    char *end;
+    unsigned long byte;
+    int n = 0;
+
+    while(*line){
+        if(*line == ' ' || *line == '\t' || *line == ',' || *line == '\n' || *line == '\r'){
+            line++;
+            continue;
+        }
+        byte = strtoul(line, &end, 16);
+        if(end == line) break;
+        if(n < max) data[n] = (unsigned char) byte;
+        else if(byte) (*dropped)++;
+        n++;
+        line = end;
+    }
+    return n;
+}
+
+//Parses the header of a usbhid-dump block, e.g. "005:004:001:STREAM             1617489710.245521"
+static int parse_header(const char *line, const char *kind, int *iface, double *t)
+{
+    char word[16];
+
+    if(sscanf(line, "%*u:%*u:%d:%15s %lf", iface, word, t) != 3) return 0;
+    return !strcmp(word, kind);
+}
+
+//Length of the report as the driver sees it (urb->actual_length)
+static int report_len(struct report *r)
+{
+    return r->len < MAX_REPORT ? r->len : MAX_REPORT;
+}
+
+static struct report *add_report(struct trace *trace)
+{
+    struct report *r;
+
+    if(trace->count == trace->capacity){
+        trace->capacity = trace->capacity ? 2*trace->capacity : 1024;
+        trace->reports = realloc(trace->reports, trace->capacity * sizeof(struct report));
+        if(!trace->reports){
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+    }
+    r = &trace->reports[trace->count++];
+    memset(r, 0, sizeof(*r));
+    r->t = -1;
+    return r;
+}
+
+//Reads the report descriptor of the interface iface from a dump of "usbhid-dump -e descriptor" (see debug/Readme.org).
+//With iface < 0, the first descriptor the driver recognizes as a mouse (X and Y found) is taken.
+static int load_descriptor(const char *path, int iface, unsigned char *desc, int *desc_len, struct report_positions *pos)
+{
+    FILE *f = fopen(path, "r");
+    char line[MAX_LINE];
+    double t;
+    int len = -1, cur, dropped = 0, found = -1;
+
+    if(!f){
+        perror(path);
+        return -1;
+    }
+
+    //A descriptor is complete at the next header or at the end of the file
+    while(1){
+        int eof = !fgets(line, sizeof(line), f);
+
+        if(eof || parse_header(line, "DESCRIPTOR", &cur, &t)){
+            if(len > 0 && (iface < 0 || found == iface)){
+                memset(pos, 0, sizeof(*pos));
+                if(parse_report_desc(desc, len, pos) >= 0 && pos->x.size && pos->y.size)
+                    break;
+                if(iface >= 0) len = -1;
+            }
+            if(eof){
+                len = -1;
+                break;
+            }
+            found = cur;
+            len = 0;
+            continue;
+        }
+        if(len >= 0)
+            len += parse_bytes(line, desc + len, MAX_DESCRIPTOR - len, &dropped);
+    }
+    fclose(f);
+
+    if(len <= 0){
+        fprintf(stderr, "%s: No mouse report descriptor found\n", path);
+        return -1;
+    }
+    *desc_len = len < MAX_DESCRIPTOR ? len : MAX_DESCRIPTOR;
+    return found;
+}
+
+//Reads a packet trace. Two formats are understood:
+// - One report per line, optionally prefixed by a timestamp in seconds: "[<t>:] 0x01, 0x00, ..." (see debug/devices/packets)
+// - The output of "usbhid-dump -e stream", where only reports of interface iface are taken
+static int load_trace(const char *path, int iface, struct trace *trace)
+{
+    FILE *f = fopen(path, "r");
+    char line[MAX_LINE];
+    unsigned char data[MAX_REPORT];
+    struct report *r = NULL;
+    double t;
+    int cur, dropped = 0, len, stream = 0;
+
+    if(!f){
+        perror(path);
+        return -1;
+    }
+
+    while(fgets(line, sizeof(line), f)){
+        char *p = line, *colon;
+
+        if(*p == '#') continue;
+        memset(data, 0, sizeof(data));
+
+        //usbhid-dump: A header starts a new report, the indented lines below it hold its bytes
+        if(parse_header(line, "STREAM", &cur, &t)){
+            stream = 1;
+            r = NULL;
+            if(iface < 0 || cur == iface){
+                r = add_report(trace);
+                r->t = t;
+            }
+            continue;
+        }
+        if(stream && (*p == ' ' || *p == '\t')){
+            int offset = r && r->len < MAX_REPORT ? r->len : MAX_REPORT;
+            if(r) r->len += parse_bytes(p, r->data + offset, MAX_REPORT - offset, &dropped);
+            continue;
+        }
+        stream = 0;
+
+        //One report per line
+        colon = strchr(p, ':');
+        t = -1;
+        if(colon){
+            t = strtod(p, NULL);
+            p = colon + 1;
+        }
+        len = parse_bytes(p, data, MAX_REPORT, &dropped);
+        if(!len) continue;
+
+        r = add_report(trace);
+        r->t = t;
+        r->len = len;
+        memcpy(r->data, data, sizeof(data));
+    }
+    fclose(f);
+
+    if(dropped)
+        fprintf(stderr, "Warning: %d non-zero bytes beyond %d bytes of a report were dropped\n", dropped, MAX_REPORT);
+    if(!trace->count){
+        fprintf(stderr, "%s: No reports found\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+//Assigns the time of each report in ns relative to the first one. Without timestamps in the trace or with a given rate, reports are spaced evenly
+static s64 *report_times(struct trace *trace, double rate, s64 *duration)
+{
+    s64 *times = malloc(trace->count * sizeof(s64));
+    int i, stamped = rate <= 0;
+
+    for(i = 0; stamped && i < trace->count; i++)
+        stamped = trace->reports[i].t >= 0;
+    if(!stamped && rate <= 0)
+        rate = 1000;
+
+    for(i = 0; i < trace->count; i++){
+        if(stamped) times[i] = (s64) ((trace->reports[i].t - trace->reports[0].t) * NSEC_PER_SEC);
+        else times[i] = (s64) (i * NSEC_PER_SEC / rate);
+    }
+    //The trace is looped, so one more report interval passes until the first report comes again
+    *duration = times[trace->count - 1] + (trace->count > 1 ? times[trace->count - 1] / (trace->count - 1) : NSEC_PER_MSEC);
+    return times;
+}
+
+static s64 now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (s64) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+//Feeds the trace in real time into a virtual mouse of the loaded kernel module. It comes out of an evdev node named LEETMOUSE_INJECT_NAME
+static int inject(const char *path, unsigned char *desc, int desc_len, struct trace *trace, s64 *times)
+{
+    struct {
+        struct leetmouse_inject hdr;
+        unsigned char data[MAX_REPORT];
+    } w;
+    struct timespec ts;
+    s64 start, late, max_late = 0;
+    int fd = open(path, O_WRONLY), i, len;
+
+    if(fd < 0){
+        perror(path);
+        return 1;
+    }
+    if(write(fd, desc, desc_len) != desc_len){
+        perror("Cannot create the virtual mouse");
+        close(fd);
+        return 1;
+    }
+    //Give udev and the readers of the new input device some time to pick it up
+    sleep(1);
+
+    start = now_ns();
+    for(i = 0; i < trace->count; i++){
+        ts.tv_sec = (start + times[i]) / NSEC_PER_SEC;
+        ts.tv_nsec = (start + times[i]) % NSEC_PER_SEC;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+
+        late = now_ns() - start - times[i];
+        if(late > max_late) max_late = late;
+
+        //The driver stamps the report itself, like an URB completion
+        len = report_len(&trace->reports[i]);
+        w.hdr.time = 0;
+        memcpy(w.data, trace->reports[i].data, len);
+        if(write(fd, &w, sizeof(w.hdr) + len) < 0){
+            perror("Cannot inject report");
+            break;
+        }
+    }
+    printf("# Injected %d reports over %.3f ms into %s, at most %.1f us late\n", i, (now_ns() - start) / 1e6, path, max_late / 1e3);
+
+    close(fd);
+    return i < trace->count;
+}
+
+//Loads the points of the custom curve (AccelerationMode 4): One "speed sensitivity" pair per line
+static int load_curve(const char *path)
+{
+    float points[CURVE_POINTS * 2];
+    char line[MAX_LINE];
+    FILE *f = fopen(path, "r");
+    int n = 0, ret;
+
+    if(!f){
+        perror(path);
+        return -1;
+    }
+    while(fgets(line, sizeof(line), f)){
+        if(line[0] == '#') continue;
+        if(n == CURVE_POINTS){
+            fprintf(stderr, "%s: More than %d points\n", path, CURVE_POINTS);
+            fclose(f);
+            return -1;
+        }
+        if(sscanf(line, "%f %f", &points[2*n], &points[2*n + 1]) == 2) n++;
+    }
+    fclose(f);
+
+    ret = accel_set_curve(points, n * 2 * sizeof(float));
+    if(ret)
+        fprintf(stderr, "%s: Invalid curve (error %d). Speeds must increase strictly\n", path, ret);
+    return ret;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "Usage: %s [options] <descriptor_raw.txt> <trace.txt>\n"
+        "  -i <interface>    Interface of the descriptor (and of a usbhid-dump stream) to use. Default: The first mouse\n"
+        "  -r <rate>         Replay at this polling rate in Hz instead of the timestamps of the trace. Default without timestamps: 1000\n"
+        "  -n <reports>      Process at least this many reports in the benchmark. Default: %d\n"
+        "  -p <name>=<value> Set a module parameter, e.g. -p Acceleration=0.3. Can be given multiple times\n"
+        "  -c <points.txt>   Load the points of the custom curve (AccelerationMode 4) from a file\n"
+        "  -q                Do not print the output deltas\n"
+        "  -k <device>       Inject the trace into the kernel module instead, e.g. -k /dev/leetmouse-inject\n",
+        name, MIN_REPORTS);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned char desc[MAX_DESCRIPTOR];
+    struct report_positions pos;
+    struct trace trace = {NULL, 0, 0};
+    struct accel_state state;
+    s64 *times, duration, start, elapsed;
+    double rate = 0, tracked;
+    long total = MIN_REPORTS, processed = 0, loops, l;
+    int iface = -1, quiet = 0, failed = 0, opt, i, ret, desc_len;
+    const char *inject_path = NULL;
+    int btn, x, y, wheel, fields, sum_in[2] = {0, 0}, sum_out[2] = {0, 0}, rejected = 0, dropped = 0;
+    char *eq;
+
+    while((opt = getopt(argc, argv, "i:r:n:p:c:qk:")) != -1){
+        switch(opt){
+        case 'i': iface = atoi(optarg); break;
+        case 'r': rate = strtod(optarg, NULL); break;
+        case 'n': total = atol(optarg); break;
+        case 'q': quiet = 1; break;
+        case 'k': inject_path = optarg; break;
+        case 'c':
+            if(load_curve(optarg))
+                return 1;
+            break;
+        case 'p':
+            eq = strchr(optarg, '=');
+            if(!eq){
+                usage(argv[0]);
+                return 1;
+            }
+            *eq = 0;
+            ret = shim_param_set(optarg, eq + 1);
+            if(ret){
+                fprintf(stderr, "Cannot set parameter %s to %s (error %d)\n", optarg, eq + 1, ret);
+                return 1;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if(argc - optind != 2){
+        usage(argv[0]);
+        return 1;
+    }
+
+    iface = load_descriptor(argv[optind], iface, desc, &desc_len, &pos);
+    if(iface < 0 || load_trace(argv[optind + 1], iface, &trace))
+        return 1;
+    times = report_times(&trace, rate, &duration);
+
+    if(inject_path)
+        return inject(inject_path, desc, desc_len, &trace, times);
+
+    ret = accel_init();
+    if(ret){
+        fprintf(stderr, "accel_init() failed with error %d\n", ret);
+        return 1;
+    }
+
+    //First pass: Show what the driver would report to the input subsystem
+    accel_init_state(&state);
+    if(!quiet)
+        printf("# t [us]\tbtn\tin x\tin y\tin whl\t-> out x\tout y\tout whl\n");
+    for(i = 0; i < trace.count; i++){
+        shim_set_clock(times[i]);
+        fields = extract_mouse_events(trace.reports[i].data, report_len(&trace.reports[i]), &pos, &btn, &x, &y, &wheel);
+        if(!(fields & (FIELD_X | FIELD_Y | FIELD_WHEEL))){
+            dropped++;
+            continue;
+        }
+        sum_in[0] += x;
+        sum_in[1] += y;
+        if(!quiet)
+            printf("%.1f\t%d\t%d\t%d\t%d", times[i] / 1000.0, btn, x, y, wheel);
+
+        ret = accelerate(&state, times[i], &x, &y, &wheel);
+        if(ret){
+            rejected++;
+            if(!quiet) printf("\t-> rejected (%d)\n", ret);
+            continue;
+        }
+        sum_out[0] += x;
+        sum_out[1] += y;
+        if(!quiet)
+            printf("\t-> %d\t%d\t%d\n", x, y, wheel);
+    }
+
+    //The polling interval the driver tracked has to match the replay rate. Otherwise, it computes the speeds with a wrong frametime
+    tracked = state.interval / 1e3;
+    if(rate > 0 && fabs(tracked - 1e6 / rate) > 0.25 * 1e6 / rate){
+        fprintf(stderr, "Tracked polling interval %.1f us does not match the replay rate of %.0f Hz (%.1f us)\n", tracked, rate, 1e6 / rate);
+        failed = 1;
+    }
+
+    //Second pass: Benchmark. The trace is looped, while the clock keeps running
+    loops = (total + trace.count - 1) / trace.count;
+    accel_init_state(&state);
+    start = now_ns();
+    for(l = 0; l < loops; l++){
+        for(i = 0; i < trace.count; i++){
+            ktime_t now = l * duration + times[i];
+
+            shim_set_clock(now);
+            fields = extract_mouse_events(trace.reports[i].data, report_len(&trace.reports[i]), &pos, &btn, &x, &y, &wheel);
+            if(fields & (FIELD_X | FIELD_Y | FIELD_WHEEL))
+                accelerate(&state, now, &x, &y, &wheel);
+        }
+    }
+    elapsed = now_ns() - start;
+    processed = loops * trace.count;
+
+    printf("# Interface %d, %d reports over %.3f ms, %d without motion, %d rejected by accelerate()\n", iface, trace.count, duration / 1e6, dropped, rejected);
+    printf("# Sum of deltas: in (%d, %d), out (%d, %d)\n", sum_in[0], sum_in[1], sum_out[0], sum_out[1]);
+    printf("# Polling interval tracked by the driver: %.1f us\n", tracked);
+    printf("# %ld reports in %.3f ms: %.1f ns/report, %.0f reports/s\n",
+        processed, elapsed / 1e6, (double) elapsed / processed, processed * 1e9 / elapsed);
+    printf("# Share of the report interval at 8000 Hz: %.3f %%\n", (double) elapsed / processed / 125000 * 100);
+
+    accel_exit();
+    free(times);
+    free(trace.reports);
+    return failed;
+}
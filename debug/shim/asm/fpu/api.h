@@ -0,0 +1,24 @@
+#ifndef _SHIM_ASM_FPU_API_H
+#define _SHIM_ASM_FPU_API_H
+
+// Userspace stand-in for <asm/fpu/api.h>
+// Userspace always owns its FPU state. The hooks only count the FPU sections and can simulate an unusable FPU (see shim.h)
+
+extern int shim_fpu_usable;
+extern unsigned long shim_fpu_sections;
+
+static inline bool irq_fpu_usable(void)
+{
+    return shim_fpu_usable;
+}
+
+static inline void kernel_fpu_begin(void)
+{
+    shim_fpu_sections++;
+}
+
+static inline void kernel_fpu_end(void)
+{
+}
+
+#endif //_SHIM_ASM_FPU_API_H
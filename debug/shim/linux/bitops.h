@@ -0,0 +1,14 @@
+#ifndef _SHIM_LINUX_BITOPS_H
+#define _SHIM_LINUX_BITOPS_H
+
+// Userspace stand-in for <linux/bitops.h>
+
+#include <linux/types.h>
+
+// Position of the most significant set bit, counted from 1. 0 if no bit is set
+static inline int fls64(u64 x)
+{
+    return x ? 64 - __builtin_clzll(x) : 0;
+}
+
+#endif //_SHIM_LINUX_BITOPS_H
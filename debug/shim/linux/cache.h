@@ -0,0 +1,9 @@
+#ifndef _SHIM_LINUX_CACHE_H
+#define _SHIM_LINUX_CACHE_H
+
+// Userspace stand-in for <linux/cache.h>
+
+#define L1_CACHE_BYTES 64
+#define ____cacheline_aligned __attribute__((__aligned__(L1_CACHE_BYTES)))
+
+#endif //_SHIM_LINUX_CACHE_H
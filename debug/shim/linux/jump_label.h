@@ -0,0 +1,17 @@
+#ifndef _SHIM_LINUX_JUMP_LABEL_H
+#define _SHIM_LINUX_JUMP_LABEL_H
+
+// Userspace stand-in for <linux/jump_label.h>. Without code patching, a static key is just a flag
+
+struct static_key_false {
+    int enabled;
+};
+
+#define DEFINE_STATIC_KEY_FALSE(name) struct static_key_false name = { 0 }
+#define DECLARE_STATIC_KEY_FALSE(name) extern struct static_key_false name
+#define static_branch_unlikely(key) __builtin_expect(!!(key)->enabled, 0)
+#define static_branch_enable(key) ((key)->enabled = 1)
+#define static_branch_disable(key) ((key)->enabled = 0)
+#define static_key_enabled(key) ((key)->enabled)
+
+#endif //_SHIM_LINUX_JUMP_LABEL_H
@@ -0,0 +1,35 @@
+#ifndef _SHIM_LINUX_KERNEL_H
+#define _SHIM_LINUX_KERNEL_H
+
+// Userspace stand-in for <linux/kernel.h>
+
+#include <linux/types.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+// The kernel log goes to stderr, so it does not interfere with the output of the tools
+#define KERN_SOH "\001"
+#define KERN_CONT KERN_SOH "c"
+#define KERN_INFO KERN_SOH "6"
+#define KERN_WARNING KERN_SOH "4"
+#define KERN_ERR KERN_SOH "3"
+
+int printk(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+#define min_t(type, a, b) ((type) (a) < (type) (b) ? (type) (a) : (type) (b))
+#define max_t(type, a, b) ((type) (a) > (type) (b) ? (type) (a) : (type) (b))
+#define container_of(ptr, type, member) ((type *) ((char *) (ptr) - offsetof(type, member)))
+
+// HID data is little-endian, as is every machine this runs on
+#define le16_to_cpu(x) (x)
+#define le32_to_cpu(x) (x)
+
+#define PAGE_SIZE 4096
+#define scnprintf snprintf
+
+int kstrtouint(const char *s, unsigned int base, unsigned int *res);
+int kstrtou8(const char *s, unsigned int base, u8 *res);
+
+#endif //_SHIM_LINUX_KERNEL_H
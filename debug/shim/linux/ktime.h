@@ -0,0 +1,27 @@
+#ifndef _SHIM_LINUX_KTIME_H
+#define _SHIM_LINUX_KTIME_H
+
+// Userspace stand-in for <linux/ktime.h>
+// ktime_get() reads the fake clock of the shim, which the tools set via shim_set_clock() (see shim.h)
+
+#include <linux/types.h>
+
+typedef s64 ktime_t;
+
+#define NSEC_PER_USEC 1000ll
+#define NSEC_PER_MSEC 1000000ll
+#define NSEC_PER_SEC 1000000000ll
+
+#define ktime_to_ns(t) ((s64) (t))
+#define ns_to_ktime(ns) ((ktime_t) (ns))
+#define ktime_sub(a, b) ((a) - (b))
+#define ktime_add_ns(t, ns) ((t) + (ns))
+
+extern ktime_t shim_clock;
+
+static inline ktime_t ktime_get(void)
+{
+    return shim_clock;
+}
+
+#endif //_SHIM_LINUX_KTIME_H
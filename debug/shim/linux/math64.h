@@ -0,0 +1,23 @@
+#ifndef _SHIM_LINUX_MATH64_H
+#define _SHIM_LINUX_MATH64_H
+
+// Userspace stand-in for <linux/math64.h>
+
+#include <linux/types.h>
+
+static inline s64 div64_s64(s64 dividend, s64 divisor)
+{
+    return dividend / divisor;
+}
+
+static inline s64 div_s64(s64 dividend, s32 divisor)
+{
+    return dividend / divisor;
+}
+
+static inline u64 div_u64(u64 dividend, u32 divisor)
+{
+    return dividend / divisor;
+}
+
+#endif //_SHIM_LINUX_MATH64_H
@@ -0,0 +1,17 @@
+#ifndef _SHIM_LINUX_MODULE_H
+#define _SHIM_LINUX_MODULE_H
+
+// Userspace stand-in for <linux/module.h>, so the sources in driver/ can be built into libleetmouse-core
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+
+// float.h brings its own atof(), which clashes with the one of <stdlib.h>
+#define atof leetmouse_atof
+
+// Module information is dropped
+#define MODULE_AUTHOR(x) extern int __shim_module_info
+#define MODULE_DESCRIPTION(x) extern int __shim_module_info
+#define MODULE_LICENSE(x) extern int __shim_module_info
+
+#endif //_SHIM_LINUX_MODULE_H
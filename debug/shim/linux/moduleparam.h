@@ -0,0 +1,40 @@
+#ifndef _SHIM_LINUX_MODULEPARAM_H
+#define _SHIM_LINUX_MODULEPARAM_H
+
+// Userspace stand-in for <linux/moduleparam.h>
+// Every module parameter registers itself at program start, so tools can set it by name via shim_param_set() (see shim.h)
+
+#include <linux/kernel.h>
+
+struct kernel_param;
+
+struct kernel_param_ops {
+    int (*set)(const char *val, const struct kernel_param *kp);
+    int (*get)(char *buffer, const struct kernel_param *kp);
+};
+
+struct kernel_param {
+    const char *name;
+    const struct kernel_param_ops *ops;
+    void *arg;
+    struct kernel_param *next;                      // Registry of the shim
+};
+
+void shim_register_param(struct kernel_param *kp);
+
+#define module_param_cb(name, ops, arg, perm)                                       \
+    static struct kernel_param __param_##name = { #name, ops, arg, NULL };          \
+    static void __attribute__((constructor)) __param_register_##name(void)          \
+    {                                                                               \
+        shim_register_param(&__param_##name);                                       \
+    }
+
+#define module_param_named(name, value, type, perm) \
+    module_param_cb(name, &param_ops_##type, &value, perm)
+
+#define MODULE_PARM_DESC(param, desc) extern int __shim_module_info
+
+extern const struct kernel_param_ops param_ops_byte;
+extern const struct kernel_param_ops param_ops_uint;
+
+#endif //_SHIM_LINUX_MODULEPARAM_H
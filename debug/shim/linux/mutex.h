@@ -0,0 +1,16 @@
+#ifndef _SHIM_LINUX_MUTEX_H
+#define _SHIM_LINUX_MUTEX_H
+
+// Userspace stand-in for <linux/mutex.h>. The tools are single threaded, so locking is a no-op
+
+struct mutex {
+    int locked;
+};
+
+#define DEFINE_MUTEX(name) struct mutex name = { 0 }
+#define mutex_init(lock) ((lock)->locked = 0)
+#define mutex_lock(lock) ((lock)->locked = 1)
+#define mutex_unlock(lock) ((lock)->locked = 0)
+#define lockdep_is_held(lock) ((lock)->locked)
+
+#endif //_SHIM_LINUX_MUTEX_H
@@ -0,0 +1,23 @@
+#ifndef _SHIM_LINUX_RCUPDATE_H
+#define _SHIM_LINUX_RCUPDATE_H
+
+// Userspace stand-in for <linux/rcupdate.h>. The tools are single threaded, so there are no concurrent readers to wait for
+
+#include <linux/slab.h>
+
+struct rcu_head {
+    void *next;
+};
+
+#define __rcu
+#define rcu_read_lock() do { } while(0)
+#define rcu_read_unlock() do { } while(0)
+#define rcu_dereference(p) (p)
+#define rcu_dereference_protected(p, c) (p)
+#define rcu_access_pointer(p) (p)
+#define rcu_assign_pointer(p, v) ((p) = (v))
+#define RCU_INIT_POINTER(p, v) ((p) = (v))
+#define synchronize_rcu() do { } while(0)
+#define kfree_rcu(ptr, head) kfree(ptr)
+
+#endif //_SHIM_LINUX_RCUPDATE_H
@@ -0,0 +1,15 @@
+#ifndef _SHIM_LINUX_SLAB_H
+#define _SHIM_LINUX_SLAB_H
+
+// Userspace stand-in for <linux/slab.h>
+
+#include <linux/types.h>
+
+#define GFP_KERNEL 0
+#define GFP_ATOMIC 0
+
+#define kmalloc(size, flags) malloc(size)
+#define kzalloc(size, flags) calloc(1, size)
+#define kfree(ptr) free(ptr)
+
+#endif //_SHIM_LINUX_SLAB_H
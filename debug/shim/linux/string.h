@@ -0,0 +1,8 @@
+#ifndef _SHIM_LINUX_STRING_H
+#define _SHIM_LINUX_STRING_H
+
+// Userspace stand-in for <linux/string.h>
+
+#include <linux/kernel.h>
+
+#endif //_SHIM_LINUX_STRING_H
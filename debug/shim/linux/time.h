@@ -0,0 +1,8 @@
+#ifndef _SHIM_LINUX_TIME_H
+#define _SHIM_LINUX_TIME_H
+
+// Userspace stand-in for <linux/time.h>
+
+#include <linux/ktime.h>
+
+#endif //_SHIM_LINUX_TIME_H
@@ -0,0 +1,9 @@
+#ifndef _SHIM_LINUX_VERSION_H
+#define _SHIM_LINUX_VERSION_H
+
+// Userspace stand-in for <linux/version.h>. Pretends to be a recent kernel
+
+#define KERNEL_VERSION(a, b, c) (((a) << 16) + ((b) << 8) + (c))
+#define LINUX_VERSION_CODE KERNEL_VERSION(6, 0, 0)
+
+#endif //_SHIM_LINUX_VERSION_H
@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "shim.h"
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <asm/fpu/api.h>
+#include <stdarg.h>
+
+// ########## Clock
+ktime_t shim_clock = 0;
+
+void shim_set_clock(ktime_t now)
+{
+    shim_clock = now;
+}
+
+void shim_advance_clock(s64 ns)
+{
+    shim_clock += ns;
+}
+
+// ########## FPU
+int shim_fpu_usable = 1;
+unsigned long shim_fpu_sections = 0;
+
+// ########## Kernel log
+// Mimics the line handling of the kernel: Every message without KERN_CONT starts a new line
+int printk(const char *fmt, ...)
+{
+    static int line_open = 0;
+    va_list args;
+    int ret, cont = 0;
+
+    if(fmt[0] == KERN_SOH[0] && fmt[1]){
+        cont = fmt[1] == 'c';
+        fmt += 2;
+    }
+    if(line_open && !cont) fputc('\n', stderr);
+
+    va_start(args, fmt);
+    ret = vfprintf(stderr, fmt, args);
+    va_end(args);
+
+    line_open = *fmt ? fmt[strlen(fmt) - 1] != '\n' : line_open && cont;
+    return ret;
+}
+
+// ########## String conversion
+int kstrtouint(const char *s, unsigned int base, unsigned int *res)
+{
+    char *end;
+    unsigned long val;
+
+    if(*s == '+') s++;
+    if(*s < '0' || *s > '9') return -EINVAL;
+
+    errno = 0;
+    val = strtoul(s, &end, base);
+    if(*end == '\n') end++;
+    if(*end) return -EINVAL;
+    if(errno || val > 0xffffffffu) return -ERANGE;
+
+    *res = (unsigned int) val;
+    return 0;
+}
+
+int kstrtou8(const char *s, unsigned int base, u8 *res)
+{
+    unsigned int val;
+    int ret = kstrtouint(s, base, &val);
+
+    if(ret) return ret;
+    if(val > 0xff) return -ERANGE;
+
+    *res = (u8) val;
+    return 0;
+}
+
+// ########## Module parameters
+static struct kernel_param *g_params = NULL;
+
+// Called by the constructors generated in module_param_cb()
+void shim_register_param(struct kernel_param *kp)
+{
+    kp->next = g_params;
+    g_params = kp;
+}
+
+static struct kernel_param *find_param(const char *name)
+{
+    struct kernel_param *kp;
+
+    for(kp = g_params; kp; kp = kp->next)
+        if(!strcmp(kp->name, name))
+            return kp;
+    return NULL;
+}
+
+int shim_param_set(const char *name, const char *value)
+{
+    struct kernel_param *kp = find_param(name);
+
+    if(!kp) return -ENOENT;
+    return kp->ops->set(value, kp);
+}
+
+int shim_param_get(const char *name, char *buffer)
+{
+    struct kernel_param *kp = find_param(name);
+
+    if(!kp) return -ENOENT;
+    return kp->ops->get(buffer, kp);
+}
+
+const char *shim_param_name(unsigned int index)
+{
+    struct kernel_param *kp;
+
+    for(kp = g_params; kp && index; kp = kp->next) index--;
+    return kp ? kp->name : NULL;
+}
+
+// Standard parameter types of the kernel, as far as they are used by the driver
+static int param_set_byte(const char *val, const struct kernel_param *kp)
+{
+    return kstrtou8(val, 0, (u8 *) kp->arg);
+}
+
+static int param_get_byte(char *buffer, const struct kernel_param *kp)
+{
+    return scnprintf(buffer, PAGE_SIZE, "%hhu\n", *((unsigned char *) kp->arg));
+}
+
+static int param_set_uint(const char *val, const struct kernel_param *kp)
+{
+    return kstrtouint(val, 0, (unsigned int *) kp->arg);
+}
+
+static int param_get_uint(char *buffer, const struct kernel_param *kp)
+{
+    return scnprintf(buffer, PAGE_SIZE, "%u\n", *((unsigned int *) kp->arg));
+}
+
+const struct kernel_param_ops param_ops_byte = {
+    .set = param_set_byte,
+    .get = param_get_byte,
+};
+
+const struct kernel_param_ops param_ops_uint = {
+    .set = param_set_uint,
+    .get = param_get_uint,
+};
@@ -0,0 +1,37 @@
+#ifndef _SHIM_H
+#define _SHIM_H
+
+// Userspace shim for the sources in driver/
+// Together with the stand-in kernel headers in this directory, driver/accel.c and driver/util.c compile unchanged into libleetmouse-core (see 'make core').
+// This header is the interface for the tools linking against that library. It controls what the kernel would usually provide: Time, the FPU and the module parameters.
+
+#include <linux/types.h>
+#include <linux/ktime.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Fake clock returned by ktime_get(). It only moves, when it is told to
+void shim_set_clock(ktime_t now);
+void shim_advance_clock(s64 ns);
+
+// Fake FPU hooks. Set shim_fpu_usable to 0 to simulate a context, where the FPU cannot be used (irq_fpu_usable() returns false)
+// shim_fpu_sections counts the calls to kernel_fpu_begin()
+extern int shim_fpu_usable;
+extern unsigned long shim_fpu_sections;
+
+// Module parameters, as they would be written to/read from /sys/module/leetmouse/parameters/<name>
+// shim_param_set returns 0 on success, -ENOENT for unknown parameters or the error of the parameter's setter
+// shim_param_get returns the number of characters written to buffer (at least PAGE_SIZE bytes) or a negative error
+int shim_param_set(const char *name, const char *value);
+int shim_param_get(const char *name, char *buffer);
+
+// Iterates over all registered parameters. Returns NULL after the last one
+const char *shim_param_name(unsigned int index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //_SHIM_H
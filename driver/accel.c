@@ -3,11 +3,17 @@
 #include "accel.h"
 #include "util.h"
 #include "float.h"
+#include "fixed.h"
 #include "config.h"
+#include <linux/bitops.h> /* fls64 */
 #include <linux/kernel.h>
 #include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/rcupdate.h>
+#include <linux/slab.h>
 #include <linux/time.h>
-#include <linux/string.h> /* strlen */
+#include <linux/string.h> /* strcspn */
 
 /* Needed for kernel_fpu_begin/end */
 #include <linux/version.h>
@@ -28,14 +34,269 @@ MODULE_AUTHOR("Klaus Zipfel <klaus (at) zipfel (dot) family>");
 #define _s(x) #x
 #define s(x) _s(x)
 
-/* Convenient helper for float based parameters,
-   which are passed via a string to this module
-   (must be individually parsed via atof() - available in util.c)
+/* ########## Acceleration parameters */
+
+struct accel_params;
+
+/* Accelerates a single report with a set of parameters */
+typedef int (*accel_kernel)(struct accel_state *state, struct accel_params *p, ktime_t now, int *x, int *y, int *wheel);
+
+/* A complete, immutable set of acceleration parameters.
+   Whenever a parameter is written, a new block is built in process
+   context (including the curve cache) and published via RCU.
+   The IRQ path only loads the current pointer: It never blocks, never
+   parses anything and never sees a half-updated set of parameters.
+   Note: The float members may only be accessed within
+   kernel_fpu_begin()/kernel_fpu_end()
+*/
+struct accel_params {
+  /* Values as written by the user */
+  unsigned int AccelerationMode;
+  unsigned int Gain;
+  unsigned int FixedPoint;
+  unsigned int Precision;
+  unsigned int LutSize;
+  unsigned int ReferenceInterval;
+  unsigned int SpeedWindow;
+  float SpeedCap;
+  float Sensitivity;
+  float Acceleration;
+  float SensitivityCap;
+  float Offset;
+  float Exponent;
+  float Midpoint;
+  float OutputOffset;
+  float Smoothness;
+  float ScrollsPerTick;
+  float LutRange;
+  /* Points of the custom curve: Sensitivity (y) over speed (x), sorted by speed */
+  unsigned int curve_len;
+  float curve_x[CURVE_POINTS];
+  float curve_y[CURVE_POINTS];
+
+  /* Derived when the block is built */
+  s64 ref_ns;                           /* ReferenceInterval in ns */
+  s64 window_ns;                        /* SpeedWindow in ns */
+  s64 fx_SpeedCap;
+  s64 fx_Sensitivity;
+  s64 fx_Acceleration;
+  s64 fx_SensitivityCap;
+  s64 fx_Offset;
+  s64 fx_Exponent;
+  s64 fx_Midpoint;
+  s64 fx_OutputOffset;
+  s64 fx_ScrollsPerTick;
+
+  /* Constants of the curves, see update_constants() */
+  float nat_limit;
+  float nat_diff;
+  float nat_rate;
+  unsigned int jump_smooth;
+  float jump_diff;
+  float jump_rate;
+  float sync_l;
+  float sync_g;
+  float sync_log;
+  float sync_sharp;
+  float sync_inv_sharp;
+  s64 fx_nat_limit;
+  s64 fx_nat_diff;
+  s64 fx_nat_rate;
+  s64 fx_jump_diff;
+  s64 fx_jump_rate;
+  s64 fx_sync_l;
+  s64 fx_sync_g;
+  s64 fx_sync_log;
+  s64 fx_sync_sharp;
+  s64 fx_sync_inv_sharp;
+
+  /* Custom curve: Monotone cubic through its points. Slope at each point
+     and inverse width of each segment
+  */
+  float curve_m[CURVE_POINTS];
+  float curve_inv_h[CURVE_POINTS];
+  s64 fx_curve_x[CURVE_POINTS];
+  s64 fx_curve_y[CURVE_POINTS];
+  s64 fx_curve_m[CURVE_POINTS];
+
+  /* Curve cache: The active curve, sampled from speed 0 to LutRange
+     into lut_len entries. A report only costs one table lookup with
+     linear interpolation, no matter which mode is selected.
+     The entries are spaced like floating point numbers, see lut_pos().
+     So they are dense at low speeds, where most of the motion happens
+     and most curves bend the most.
+     Both engines get their own copy of the table.
+  */
+  unsigned int lut_len;                 /* Valid entries. 0 = The cache is disabled */
+  float lut_scale;                      /* Speed to the position 1 + speed * lut_scale */
+  float lut_end;                        /* Speed of the last entry */
+  s64 fx_lut_scale;
+  s64 fx_lut_end;
+  float lut[LUT_SIZE];
+  s64 lut_fx[LUT_SIZE];
+
+  /* Gain: Where the cache ends. The area under the curve up to there
+     and the curve's value there
+  */
+  float gain_x;
+  float gain_area;
+  float gain_f;
+  s64 fx_gain_x;
+  s64 fx_gain_area;
+  s64 fx_gain_f;
+
+  /* The acceleration of a report, picked by select_kernel() */
+  unsigned int identity;                /* Sensitivity and acceleration leave the motion as it is */
+  accel_kernel kernel;
+
+  struct rcu_head rcu;
+};
+
+/* The parameters the next block is built from (protected by g_params_lock).
+   Static float assignment happens at compile-time and thus is safe here.
+*/
+static struct accel_params g_staging = {
+  .AccelerationMode = ACCELERATION_MODE,
+  .Gain = GAIN,
+  .FixedPoint = FIXED_POINT,
+  .Precision = PRECISION,
+  .LutSize = LUT_SIZE,
+  .ReferenceInterval = REFERENCE_INTERVAL,
+  .SpeedWindow = SPEED_WINDOW,
+  .SpeedCap = SPEED_CAP,
+  .Sensitivity = SENSITIVITY,
+  .Acceleration = ACCELERATION,
+  .SensitivityCap = SENS_CAP,
+  .Offset = OFFSET,
+  .Exponent = EXPONENT,
+  .Midpoint = MIDPOINT,
+  .OutputOffset = OUTPUT_OFFSET,
+  .Smoothness = SMOOTHNESS,
+  .ScrollsPerTick = SCROLLS_PER_TICK,
+  .LutRange = LUT_RANGE,
+};
+static DEFINE_MUTEX(g_params_lock);
+static struct accel_params __rcu *g_params;
+
+static int publish_params(void);
+static void select_kernel(struct accel_params *p);
+
+/* Float based parameters are passed via a string to this module
+   and parsed via atof() (available in float.h) when written
 */
-#define PARAM_F(param, default, desc)                           \
-  float g_##param = default;                                    \
-  static char* g_param_##param = s(default);                    \
-  module_param_named(param, g_param_##param, charp, 0644);      \
+#define PARAM_STR_LEN 16
+
+struct param_f {
+  char str[PARAM_STR_LEN];              /* As written by the user */
+  size_t offset;                        /* Member of struct accel_params */
+};
+
+static int
+param_set_f(const char *val, const struct kernel_param *kp)
+{
+  struct param_f *param = kp->arg;
+  size_t len = strcspn(val, "\n");
+  float result;
+  int ret;
+
+  if(len >= PARAM_STR_LEN)
+    return -EINVAL;
+
+  mutex_lock(&g_params_lock);
+  kernel_fpu_begin();
+  ret = atof(val, len, &result);
+  if(!ret)
+    *(float *) ((char *) &g_staging + param->offset) = result;
+  kernel_fpu_end();
+
+  if(!ret)
+    {
+      memcpy(param->str, val, len);
+      param->str[len] = 0;
+      ret = publish_params();
+    }
+  mutex_unlock(&g_params_lock);
+
+  return ret;
+}
+
+static int
+param_get_f(char *buffer, const struct kernel_param *kp)
+{
+  struct param_f *param = kp->arg;
+  int ret;
+
+  mutex_lock(&g_params_lock);
+  ret = scnprintf(buffer, PAGE_SIZE, "%s\n", param->str);
+  mutex_unlock(&g_params_lock);
+
+  return ret;
+}
+
+static const struct kernel_param_ops param_ops_f = {
+  .set = param_set_f,
+  .get = param_get_f,
+};
+
+#define PARAM_F(param, default, desc)                                   \
+  static struct param_f g_param_##param = {                             \
+    s(default), offsetof(struct accel_params, param)                    \
+  };                                                                    \
+  module_param_cb(param, &param_ops_f, &g_param_##param, 0644);         \
+  MODULE_PARM_DESC(param, desc);
+
+/* Integer based acceleration parameters */
+struct param_u {
+  unsigned int min;                     /* Lowest valid value */
+  unsigned int max;                     /* Highest valid value */
+  size_t offset;                        /* Member of struct accel_params */
+};
+
+static int
+param_set_u(const char *val, const struct kernel_param *kp)
+{
+  struct param_u *param = kp->arg;
+  unsigned int result;
+  int ret;
+
+  ret = kstrtouint(val, 0, &result);
+  if(ret)
+    return ret;
+  if(result < param->min || result > param->max)
+    return -EINVAL;
+
+  mutex_lock(&g_params_lock);
+  *(unsigned int *) ((char *) &g_staging + param->offset) = result;
+  ret = publish_params();
+  mutex_unlock(&g_params_lock);
+
+  return ret;
+}
+
+static int
+param_get_u(char *buffer, const struct kernel_param *kp)
+{
+  struct param_u *param = kp->arg;
+  int ret;
+
+  mutex_lock(&g_params_lock);
+  ret = scnprintf(buffer, PAGE_SIZE, "%u\n",
+                  *(unsigned int *) ((char *) &g_staging + param->offset));
+  mutex_unlock(&g_params_lock);
+
+  return ret;
+}
+
+static const struct kernel_param_ops param_ops_u = {
+  .set = param_set_u,
+  .get = param_get_u,
+};
+
+#define PARAM_U(param, min, max, desc)                                  \
+  static struct param_u g_param_##param = {                             \
+    min, max, offsetof(struct accel_params, param)                      \
+  };                                                                    \
+  module_param_cb(param, &param_ops_u, &g_param_##param, 0644);         \
   MODULE_PARM_DESC(param, desc);
 
 #define PARAM(param, default, desc)                     \
@@ -49,74 +310,933 @@ MODULE_AUTHOR("Klaus Zipfel <klaus (at) zipfel (dot) family>");
 PARAM(no_bind, 0,
       "This will disable binding to this driver via 'leetmouse_bind' by udev.");
 PARAM(update, 0,
-      "Triggers an update of the acceleration parameters below");
-PARAM(AccelerationMode, ACCELERATION_MODE,
-      "Sets the algorithm to be used for acceleration");
+      "Deprecated: The acceleration parameters below are applied as soon as they are written. Kept for compatibility.");
 
-/* Acceleration parameters
-   (type pchar. Converted to float via "updata_params"
-   triggered by /sys/module/leetmouse/parameters/update)
-*/
+/* Acceleration parameters (published as a whole, whenever one of them is written) */
+PARAM_U(AccelerationMode, 1, 8,
+        "Sets the algorithm to be used for acceleration: 1 = linear, 2 = classic, 3 = motivity, 4 = custom curve (see CurvePoints), 5 = power, 6 = natural, 7 = jump, 8 = synchronous");
+PARAM_U(Gain, 0, 1,
+        "Take the curve as the gain (slope of the output over the input speed) instead of as the sensitivity");
+PARAM_U(FixedPoint, 0, 1,
+        "Use the integer (Q16.16) acceleration engine, which never touches the FPU");
+PARAM_U(Precision, PRECISION_FAST, PRECISION_EXACT,
+        "Precision of the float math: 0 = fast (Blinn's approximations), 1 = balanced, 2 = exact (within 1 ulp, evaluated in double precision)");
+PARAM_U(ReferenceInterval, 1, 100000,
+        "Time base of all speeds in µs. The curves are tuned in counts per this interval (default: counts per ms).");
+PARAM_U(SpeedWindow, 0, 50000,
+        "Time in µs the speed is averaged over (at most the last 128 reports). 0 takes the speed of each report on its own.");
 PARAM_F(SpeedCap, SPEED_CAP,
         "Limit the maximum pointer speed before applying acceleration.");
 PARAM_F(Sensitivity, SENSITIVITY, "Mouse base sensitivity.");
 PARAM_F(Acceleration, ACCELERATION, "Mouse acceleration sensitivity.");
-PARAM_F(SensitivityCap, SENS_CAP, "Cap maximum sensitivity.");
+PARAM_F(SensitivityCap, SENS_CAP, "Cap maximum sensitivity of all modes. 0 disables it. Natural approaches it.");
 PARAM_F(Offset, OFFSET, "Mouse base sensitivity.");
-PARAM_F(Exponent, EXPONENT, "Exponent for algorithms that use it"); 
-PARAM_F(Midpoint, MIDPOINT, "Midpoint for sigmoid function"); 
+PARAM_F(Exponent, EXPONENT, "Exponent for algorithms that use it");
+PARAM_F(Midpoint, MIDPOINT, "Midpoint for sigmoid function, speed of the jump and synchronous speed");
+PARAM_F(OutputOffset, OUTPUT_OFFSET, "Added to the sensitivity of power");
+PARAM_F(Smoothness, SMOOTHNESS, "Smoothness of jump and synchronous. 0 = sharp");
 PARAM_F(ScrollsPerTick, SCROLLS_PER_TICK,
         "Amount of lines to scroll per scroll-wheel tick.");
+PARAM_F(LutRange, LUT_RANGE,
+        "Highest speed sampled into the curve cache. Faster movements evaluate the curve directly.");
+PARAM_U(LutSize, 0, LUT_SIZE,
+        "Number of entries of the curve cache (at most LUT_SIZE in 'config.h'). 0 disables it.");
 
 
-/* Updates the acceleration parameters. This is purposely done with a delay!
-   First, to not hammer too much the logic in "accelerate()", which is called VERY OFTEN!
-   Second, to fight possible cheating. However, this can be OFC changed, since we are OSS...
+/* ########## Custom curve */
+
+/* The points of the custom curve are joined by a monotone cubic Hermite
+   spline (Fritsch-Carlson): Between two points, the sensitivity never
+   overshoots, so a monotone point list stays monotone. Below the first
+   and above the last point, the sensitivity is held.
+   Evaluating it needs a binary search, but it is sampled into the
+   curve cache like any other curve.
 */
-#define PARAM_UPDATE(param) atof(g_param_##param, strlen(g_param_##param) , &g_##param);
 
-static ktime_t g_next_update = 0;
+/* Calculates the slopes of the spline. Must be used within kernel_fpu_begin()/kernel_fpu_end() */
+INLINE void
+update_curve(struct accel_params *p)
+{
+  unsigned int i, n = p->curve_len;
+  float d, d_prev = 0, a, b, s;
 
+  if(n < 2)
+    return;
+
+  /* Secants as the first guess. Extrema get a flat tangent */
+  for(i = 0; i < n - 1; i++)
+    {
+      p->curve_inv_h[i] = 1.0f / (p->curve_x[i + 1] - p->curve_x[i]);
+      d = (p->curve_y[i + 1] - p->curve_y[i]) * p->curve_inv_h[i];
+      if(!i)
+        p->curve_m[i] = d;
+      else
+        p->curve_m[i] = d_prev * d > 0 ? (d_prev + d) / 2 : 0;
+      d_prev = d;
+    }
+  p->curve_m[n - 1] = d_prev;
+
+  /* Limit the slopes of each segment to the circle of radius 3,
+     which keeps it monotone
+  */
+  for(i = 0; i < n - 1; i++)
+    {
+      d = (p->curve_y[i + 1] - p->curve_y[i]) * p->curve_inv_h[i];
+      if(d == 0)
+        {
+          p->curve_m[i] = 0;
+          p->curve_m[i + 1] = 0;
+          continue;
+        }
+      a = p->curve_m[i] / d;
+      b = p->curve_m[i + 1] / d;
+      s = a * a + b * b;
+      if(s > 9)
+        {
+          F_sqrt(&s, PRECISION_EXACT);
+          s = 3 / s;
+          p->curve_m[i] = s * a * d;
+          p->curve_m[i + 1] = s * b * d;
+        }
+    }
+
+  for(i = 0; i < n; i++)
+    {
+      p->fx_curve_x[i] = (s64) (p->curve_x[i] * FX_ONE);
+      p->fx_curve_y[i] = (s64) (p->curve_y[i] * FX_ONE);
+      p->fx_curve_m[i] = (s64) (p->curve_m[i] * FX_ONE);
+    }
+}
+
+/* Evaluates the spline. Must be used within kernel_fpu_begin()/kernel_fpu_end() */
+INLINE float
+custom_curve(struct accel_params *p, float speed)
+{
+  unsigned int lo = 0, hi, mid;
+  float t, t2, t3, h;
+
+  if(p->curve_len < 2)
+    return 1;
+  hi = p->curve_len - 1;
+  if(speed <= p->curve_x[0])
+    return p->curve_y[0];
+  if(speed >= p->curve_x[hi])
+    return p->curve_y[hi];
+
+  while(hi - lo > 1)
+    {
+      mid = (lo + hi) / 2;
+      if(speed < p->curve_x[mid])
+        hi = mid;
+      else
+        lo = mid;
+    }
+
+  /* Cubic Hermite basis */
+  h = p->curve_x[hi] - p->curve_x[lo];
+  t = (speed - p->curve_x[lo]) * p->curve_inv_h[lo];
+  t2 = t * t;
+  t3 = t2 * t;
+  return (2 * t3 - 3 * t2 + 1) * p->curve_y[lo] + (t3 - 2 * t2 + t) * h * p->curve_m[lo]
+    + (3 * t2 - 2 * t3) * p->curve_y[hi] + (t3 - t2) * h * p->curve_m[hi];
+}
+
+/* Same as custom_curve(), but in Q16.16 */
+INLINE s64
+custom_curve_fixed(struct accel_params *p, s64 speed)
+{
+  unsigned int lo = 0, hi, mid;
+  s64 t, t2, t3, h;
+
+  if(p->curve_len < 2)
+    return FX_ONE;
+  hi = p->curve_len - 1;
+  if(speed <= p->fx_curve_x[0])
+    return p->fx_curve_y[0];
+  if(speed >= p->fx_curve_x[hi])
+    return p->fx_curve_y[hi];
+
+  while(hi - lo > 1)
+    {
+      mid = (lo + hi) / 2;
+      if(speed < p->fx_curve_x[mid])
+        hi = mid;
+      else
+        lo = mid;
+    }
+
+  h = p->fx_curve_x[hi] - p->fx_curve_x[lo];
+  t = fx_div(speed - p->fx_curve_x[lo], h);
+  t2 = fx_mul(t, t);
+  t3 = fx_mul(t2, t);
+  return fx_mul(2 * t3 - 3 * t2 + FX_ONE, p->fx_curve_y[lo]) + fx_mul(fx_mul(t3 - 2 * t2 + t, h), p->fx_curve_m[lo])
+    + fx_mul(3 * t2 - 2 * t3, p->fx_curve_y[hi]) + fx_mul(fx_mul(t3 - t2, h), p->fx_curve_m[hi]);
+}
+
+/* ########## Curve constants */
+
+#define LOG2_E 1.44269504f
+#define PI 3.14159265f
+
+#define PARAM_FX(p, param) p->fx_##param = (s64) (p->param * FX_ONE);
+
+/* 2^x on the precision tier of the parameters. Limited to exponents,
+   which cannot overflow any tier. Must be used within kernel_fpu_begin()/kernel_fpu_end()
+*/
+INLINE float
+curve_exp2(struct accel_params *p, float x)
+{
+  if(x > 64)
+    x = 64;
+  if(x < -64)
+    x = -64;
+  F_exp2(&x, p->Precision);
+  return x;
+}
+
+/* log_2(x) on the precision tier of the parameters. Must be used within kernel_fpu_begin()/kernel_fpu_end() */
+INLINE float
+curve_log2(struct accel_params *p, float x)
+{
+  F_log2(&x, p->Precision);
+  return x;
+}
+
+/* Calculates everything of the curves, which does not depend on the
+   speed. All exponentials are turned into base 2.
+   Must be used within kernel_fpu_begin()/kernel_fpu_end()
+*/
 INLINE void
-updata_params(ktime_t now)
+update_constants(struct accel_params *p)
 {
-  if(!g_update) return;
-  if(now < g_next_update) return;
-  g_update = 0;
-  /* Next update is allowed after 1s of delay */
-  g_next_update = now + 1000000000ll;
+  float l;
+
+  /* Natural: SensitivityCap - (SensitivityCap - 1) * 2^(Speed * nat_rate).
+     Without a cap, it stays at 1
+  */
+  p->nat_limit = p->SensitivityCap > 0 ? p->SensitivityCap : 1;
+  p->nat_diff = p->nat_limit - 1;
+  p->nat_rate = -p->Acceleration * LOG2_E;
 
-  PARAM_UPDATE(SpeedCap);
-  PARAM_UPDATE(Sensitivity);
-  PARAM_UPDATE(Acceleration);
-  PARAM_UPDATE(SensitivityCap);
-  PARAM_UPDATE(Offset);
-  PARAM_UPDATE(ScrollsPerTick);
-  PARAM_UPDATE(Exponent);
-  PARAM_UPDATE(Midpoint);
+  /* Jump: Sigmoid of the width 2 pi / (Midpoint * Smoothness) around Midpoint.
+     A step without smoothness
+  */
+  p->jump_smooth = p->Midpoint > 0 && p->Smoothness > 0;
+  p->jump_diff = p->Acceleration - 1;
+  p->jump_rate = p->jump_smooth ? -2 * PI * LOG2_E / (p->Midpoint * p->Smoothness) : 0;
+
+  /* Synchronous: Motivity (Acceleration), gamma (Exponent) and
+     synchronous speed (Midpoint) in log_2 space. Flat, unless the
+     motivity is above 1
+  */
+  p->sync_l = 0;
+  p->sync_g = 0;
+  p->sync_log = 0;
+  p->sync_sharp = p->Smoothness > 0 ? 0.5f / p->Smoothness : 16;
+  p->sync_inv_sharp = 1 / p->sync_sharp;
+  if(p->Acceleration > 1 && p->Midpoint > 0)
+    {
+      l = p->Acceleration;
+      F_log2(&l, PRECISION_EXACT);
+      p->sync_l = l;
+      p->sync_g = p->Exponent / l;
+      l = p->Midpoint;
+      F_log2(&l, PRECISION_EXACT);
+      p->sync_log = l;
+    }
+
+  PARAM_FX(p, nat_limit);
+  PARAM_FX(p, nat_diff);
+  PARAM_FX(p, nat_rate);
+  PARAM_FX(p, jump_diff);
+  PARAM_FX(p, jump_rate);
+  PARAM_FX(p, sync_l);
+  PARAM_FX(p, sync_g);
+  PARAM_FX(p, sync_log);
+  PARAM_FX(p, sync_sharp);
+  PARAM_FX(p, sync_inv_sharp);
 }
 
-/* ########## Acceleration code */
+/* Synchronous: motivity^(sign(u) * tanh(|u|^sharp)^(1/sharp)) with
+   u = gamma / log(motivity) * log(Speed / synchronous speed)
+   Must be used within kernel_fpu_begin()/kernel_fpu_end()
+*/
+INLINE float
+sync_curve(struct accel_params *p, float speed)
+{
+  float u, z, t;
 
-/* Acceleration happens here */
-int
-accelerate(int *x, int *y, int *wheel)
+  if(!p->sync_l)
+    return 1;
+  u = p->sync_g * (curve_log2(p, speed) - p->sync_log);
+  if(u == 0)
+    return 1;
+
+  /* tanh(16) already rounds to 1 */
+  z = p->sync_sharp * curve_log2(p, u < 0 ? -u : u);
+  if(z > 4)
+    t = 1;
+  else
+    {
+      z = curve_exp2(p, z);
+      t = 1 - 2 / (curve_exp2(p, 2 * LOG2_E * z) + 1);
+      t = curve_exp2(p, curve_log2(p, t) * p->sync_inv_sharp);
+    }
+
+  return curve_exp2(p, (u < 0 ? -t : t) * p->sync_l);
+}
+
+/* Same as sync_curve(), but in Q16.16 */
+INLINE s64
+sync_curve_fixed(struct accel_params *p, s64 speed)
+{
+  s64 u, z, t;
+
+  if(!p->fx_sync_l)
+    return FX_ONE;
+  u = fx_mul(p->fx_sync_g, fx_log2(speed) - p->fx_sync_log);
+  if(!u)
+    return FX_ONE;
+
+  z = fx_mul(p->fx_sync_sharp, fx_log2(u < 0 ? -u : u));
+  if(z > FX_FROM_INT(4))
+    t = FX_ONE;
+  else
+    {
+      z = fx_exp2(z);
+      t = FX_ONE - fx_div(2 * FX_ONE, fx_exp2(fx_mul(2 * FX_LOG2_E, z)) + FX_ONE);
+      t = fx_exp2(fx_mul(fx_log2(t), p->fx_sync_inv_sharp));
+    }
+
+  return fx_exp2(fx_mul(u < 0 ? -t : t, p->fx_sync_l));
+}
+
+/* ########## Acceleration curves */
+
+/* Returns the sensitivity multiplier for a speed, which already has been
+   reduced by the offset. The kernels pass the mode as a constant, so the
+   switch folds away (see KERNELS()).
+   Must be used within kernel_fpu_begin()/kernel_fpu_end()
+*/
+INLINE float
+accel_curve(struct accel_params *p, float speed, const unsigned int mode)
 {
-  float delta_x, delta_y, delta_whl, ms, speed, accel_sens, product, motivity;
+  float product, motivity;
   const float e = 2.71828f;
-  static long buffer_x = 0;
-  static long buffer_y = 0;
-  static long buffer_whl = 0;
-  /* Static float assignment should happen at compile-time and
-     thus should be safe here. However, avoid non-static assignment
-     of floats outside kernel_fpu_begin()/kernel_fpu_end()
+
+  /* Apply acceleration if movement is over offset */
+  if(speed > 0)
+    {
+      switch (mode)
+        {
+        case 1: /* Linear acceleration */
+          // Speed * Acceleration
+          speed *= p->Acceleration;
+          speed += 1;
+          break;
+
+        case 2: /* Classic acceleration */
+          /* (Speed * Acceleration)^Exponent */
+          speed *= p->Acceleration;
+          speed += 1;
+          F_pow(&speed, &p->Exponent, p->Precision);
+          break;
+
+        case 3: /* Motivity (Sigmoid function) */
+          /* Acceleration / ( 1 + e ^ (midpoint - x)) */
+          product =  p->Midpoint-speed;
+          motivity = e;
+          F_pow(&motivity, &product, p->Precision);
+          motivity = p->Acceleration / (1 + motivity);
+          speed = motivity;
+          break;
+
+        case 4: /* Custom curve */
+          speed = custom_curve(p, speed);
+          break;
+
+        case 5: /* Power */
+          /* (Speed * Acceleration)^Exponent + OutputOffset */
+          speed *= p->Acceleration;
+          if(speed > 0)
+            F_pow(&speed, &p->Exponent, p->Precision);
+          else
+            speed = 0;
+          speed += p->OutputOffset;
+          break;
+
+        case 6: /* Natural */
+          speed = p->nat_limit - p->nat_diff * curve_exp2(p, speed * p->nat_rate);
+          break;
+
+        case 7: /* Jump */
+          /* 1 + (Acceleration - 1) / (1 + e^(-2 pi / (Midpoint * Smoothness) * (Speed - Midpoint))) */
+          if(!p->jump_smooth)
+            speed = speed >= p->Midpoint ? p->Acceleration : 1;
+          else
+            speed = 1 + p->jump_diff / (1 + curve_exp2(p, p->jump_rate * (speed - p->Midpoint)));
+          break;
+
+        case 8: /* Synchronous */
+          speed = sync_curve(p, speed);
+          break;
+        }
+    }
+
+  return speed;
+}
+
+/* Same as accel_curve(), but in Q16.16 */
+INLINE s64
+accel_curve_fixed(struct accel_params *p, s64 speed, const unsigned int mode)
+{
+  /* Apply acceleration if movement is over offset */
+  if(speed > 0)
+    {
+      switch (mode)
+        {
+        case 1: /* Linear acceleration */
+          speed = fx_mul(speed, p->fx_Acceleration) + FX_ONE;
+          break;
+
+        case 2: /* Classic acceleration */
+          speed = fx_mul(speed, p->fx_Acceleration) + FX_ONE;
+          speed = fx_pow(speed, p->fx_Exponent);
+          break;
+
+        case 3: /* Motivity (Sigmoid function) */
+          speed = fx_div(p->fx_Acceleration, FX_ONE + fx_exp(p->fx_Midpoint - speed));
+          break;
+
+        case 4: /* Custom curve */
+          speed = custom_curve_fixed(p, speed);
+          break;
+
+        case 5: /* Power */
+          speed = fx_mul(speed, p->fx_Acceleration);
+          speed = speed > 0 ? fx_pow(speed, p->fx_Exponent) : 0;
+          speed += p->fx_OutputOffset;
+          break;
+
+        case 6: /* Natural */
+          speed = p->fx_nat_limit - fx_mul(p->fx_nat_diff, fx_exp2(fx_mul(speed, p->fx_nat_rate)));
+          break;
+
+        case 7: /* Jump */
+          if(!p->jump_smooth)
+            speed = speed >= p->fx_Midpoint ? p->fx_Acceleration : FX_ONE;
+          else
+            speed = FX_ONE + fx_div(p->fx_jump_diff, FX_ONE + fx_exp2(fx_mul(p->fx_jump_rate, speed - p->fx_Midpoint)));
+          break;
+
+        case 8: /* Synchronous */
+          speed = sync_curve_fixed(p, speed);
+          break;
+        }
+    }
+
+  return speed;
+}
+
+/* SensitivityCap applies to the curves of all modes. It is applied after
+   the lookup, so the kink of the cap is not smeared over a cache entry.
+   Must be used within kernel_fpu_begin()/kernel_fpu_end()
+*/
+INLINE float
+curve_cap(struct accel_params *p, float sens)
+{
+  if(p->SensitivityCap > 0 && sens > p->SensitivityCap)
+    return p->SensitivityCap;
+  return sens;
+}
+
+/* Same as curve_cap(), but in Q16.16 */
+INLINE s64
+curve_cap_fixed(struct accel_params *p, s64 sens)
+{
+  if(p->fx_SensitivityCap > 0 && sens > p->fx_SensitivityCap)
+    return p->fx_SensitivityCap;
+  return sens;
+}
+
+/* ########## Gain */
+
+/* With Gain, the curve is the slope of the output speed over the input
+   speed (like RawAccel's gain mode), so the output speed never jumps.
+   The sensitivity then is the average of the curve from 0 to the speed:
+     sens(v) = 1/v * integral of curve(u) du from 0 to v
+   The integral is taken numerically when the parameters are built and
+   stored in the curve cache. Beyond the cache, the tail of the integral
+   is a single step of Simpson's rule, which is exact up to parabolas.
+   The curve is integrated with its cap.
+*/
+
+/* Slices of Simpson's rule per entry of the curve cache */
+#define GAIN_STEPS 4
+
+/* The curve only applies above the offset. So it is sampled slightly above zero */
+#define CURVE_MIN_SPEED 1e-6f
+
+/* Area under the curve between two speeds. Must be used within kernel_fpu_begin()/kernel_fpu_end() */
+INLINE float
+curve_area(struct accel_params *p, float from, float to)
+{
+  float h = (to - from) / GAIN_STEPS, area = 0, a, m, b;
+  unsigned int i;
+
+  a = curve_cap(p, accel_curve(p, from, p->AccelerationMode));
+  for(i = 0; i < GAIN_STEPS; i++)
+    {
+      m = curve_cap(p, accel_curve(p, from + (i + 0.5f) * h, p->AccelerationMode));
+      b = curve_cap(p, accel_curve(p, from + (i + 1) * h, p->AccelerationMode));
+      area += (a + 4 * m + b) * h / 6;
+      a = b;
+    }
+
+  return area;
+}
+
+/* Sensitivity beyond the cache. Must be used within kernel_fpu_begin()/kernel_fpu_end() */
+INLINE float
+gain_tail(struct accel_params *p, float speed, const unsigned int mode)
+{
+  float m = curve_cap(p, accel_curve(p, (p->gain_x + speed) / 2, mode));
+  float b = curve_cap(p, accel_curve(p, speed, mode));
+
+  return (p->gain_area + (speed - p->gain_x) * (p->gain_f + 4 * m + b) / 6) / speed;
+}
+
+/* Same as gain_tail(), but in Q16.16 */
+INLINE s64
+gain_tail_fixed(struct accel_params *p, s64 speed, const unsigned int mode)
+{
+  s64 m = curve_cap_fixed(p, accel_curve_fixed(p, (p->fx_gain_x + speed) / 2, mode));
+  s64 b = curve_cap_fixed(p, accel_curve_fixed(p, speed, mode));
+  s64 area = p->fx_gain_area + fx_mul(speed - p->fx_gain_x, (p->fx_gain_f + 4 * m + b) / 6);
+
+  return fx_div(area, speed);
+}
+
+/* The average of the curve below the first entries of the cache, which
+   start at 0. Like gain_tail(), a single step of Simpson's rule.
+   Must be used within kernel_fpu_begin()/kernel_fpu_end()
+*/
+INLINE float
+gain_head(struct accel_params *p, float speed, const unsigned int mode)
+{
+  float m = curve_cap(p, accel_curve(p, speed / 2, mode));
+  float b = curve_cap(p, accel_curve(p, speed, mode));
+
+  return (p->lut[0] + 4 * m + b) / 6;
+}
+
+/* Same as gain_head(), but in Q16.16 */
+INLINE s64
+gain_head_fixed(struct accel_params *p, s64 speed, const unsigned int mode)
+{
+  s64 m = curve_cap_fixed(p, accel_curve_fixed(p, speed / 2, mode));
+  s64 b = curve_cap_fixed(p, accel_curve_fixed(p, speed, mode));
+
+  return (p->lut_fx[0] + 4 * m + b) / 6;
+}
+
+/* ########## Curve cache */
+
+/* The cache is laid out like a floating point number: Each octave of the
+   position 1 + speed * lut_scale holds 2^LUT_OCTAVE_SHIFT evenly spaced
+   entries. So the entries are evenly spaced at low speeds, their
+   distance grows with the speed above and a lookup only needs the
+   exponent and the mantissa of the position.
+   Below entry LUT_DIRECT, curves with an infinite slope at 0 (Power with
+   an Exponent below 1) do not interpolate well. These speeds are
+   evaluated directly, see gain_head() for Gain.
+*/
+#define LUT_OCTAVE_SHIFT 5
+#define LUT_DIRECT 2
+
+/* Position of entry i: 2^(i / 32) * (1 + (i % 32) / 32) */
+INLINE float
+lut_pos(unsigned int i)
+{
+  unsigned int octave = i >> LUT_OCTAVE_SHIFT;
+
+  return (1 + (float) (i & ((1 << LUT_OCTAVE_SHIFT) - 1)) / (1 << LUT_OCTAVE_SHIFT)) * (1u << octave);
+}
+
+/* Samples the curve without its cap, or with Gain, its average.
+   Must be used within kernel_fpu_begin()/kernel_fpu_end()
+*/
+INLINE void
+update_lut(struct accel_params *p)
+{
+  unsigned int i, len = min_t(unsigned int, p->LutSize, LUT_SIZE);
+  float speed, range = p->LutRange, prev = CURVE_MIN_SPEED;
+
+  /* The integral of the gain lives in the cache, so Gain always has one */
+  if(p->Gain && len < 2)
+    len = LUT_SIZE;
+  if(p->Gain && range <= 0)
+    range = LUT_RANGE;
+
+  p->lut_len = 0;
+  p->gain_x = 0;
+  p->gain_area = 0;
+  p->gain_f = curve_cap(p, accel_curve(p, CURVE_MIN_SPEED, p->AccelerationMode));
+  if(len < 2 || range <= 0)
+    goto exit;
+
+  p->lut_scale = (lut_pos(len - 1) - 1) / range;
+  p->lut_end = range;
+  p->fx_lut_scale = (s64) (p->lut_scale * FX_ONE);
+  p->fx_lut_end = (s64) (p->lut_end * FX_ONE);
+
+  for(i = 0; i < len; i++)
+    {
+      speed = i ? (lut_pos(i) - 1) / p->lut_scale : CURVE_MIN_SPEED;
+      if(!p->Gain)
+        p->lut[i] = accel_curve(p, speed, p->AccelerationMode);
+      else if(!i)
+        p->lut[i] = p->gain_f;
+      else
+        {
+          p->gain_area += curve_area(p, prev, speed);
+          p->lut[i] = p->gain_area / speed;
+          prev = speed;
+        }
+      p->lut_fx[i] = (s64) (p->lut[i] * FX_ONE);
+    }
+
+  p->lut_len = len;
+  if(p->Gain)
+    {
+      p->gain_x = prev;
+      p->gain_f = curve_cap(p, accel_curve(p, prev, p->AccelerationMode));
+    }
+
+ exit:
+  p->fx_gain_x = (s64) (p->gain_x * FX_ONE);
+  p->fx_gain_area = (s64) (p->gain_area * FX_ONE);
+  p->fx_gain_f = (s64) (p->gain_f * FX_ONE);
+}
+
+/* Looks up the curve in the cache. Speeds beyond the cache are evaluated directly.
+   The bits of the position above the one of 1.0 are the index of the
+   entry (exponent and the upper bits of the mantissa), followed by the
+   fraction between it and the next entry.
+*/
+INLINE float
+curve_lookup(struct accel_params *p, float speed, const unsigned int mode)
+{
+  float pos;
+  unsigned int i, bits;
+
+  if(speed <= 0)
+    return accel_curve(p, speed, mode);
+  if(!p->lut_len || speed >= p->lut_end)
+    return p->Gain ? gain_tail(p, speed, mode) : curve_cap(p, accel_curve(p, speed, mode));
+
+  pos = 1 + speed * p->lut_scale;
+  bits = ASINT(&pos) - OneAsInt;
+  i = min_t(unsigned int, bits >> (23 - LUT_OCTAVE_SHIFT), p->lut_len - 2);
+  if(i < LUT_DIRECT)
+    return p->Gain ? gain_head(p, speed, mode) : curve_cap(p, accel_curve(p, speed, mode));
+
+  pos = (float) (bits & ((1 << (23 - LUT_OCTAVE_SHIFT)) - 1)) * (1.0f / (1 << (23 - LUT_OCTAVE_SHIFT)));
+  return curve_cap(p, p->lut[i] + (p->lut[i + 1] - p->lut[i]) * pos);
+}
+
+/* Same as curve_lookup(), but in Q16.16. The exponent of the position is
+   its most significant bit
+*/
+INLINE s64
+curve_lookup_fixed(struct accel_params *p, s64 speed, const unsigned int mode)
+{
+  s64 pos;
+  unsigned int i, octave;
+
+  if(speed <= 0)
+    return accel_curve_fixed(p, speed, mode);
+  if(!p->lut_len || speed >= p->fx_lut_end)
+    return p->Gain ? gain_tail_fixed(p, speed, mode) : curve_cap_fixed(p, accel_curve_fixed(p, speed, mode));
+
+  pos = FX_ONE + fx_mul(speed, p->fx_lut_scale);
+  octave = fls64(pos) - 1 - FX_SHIFT;
+  pos = (pos >> octave) - FX_ONE;
+  i = min_t(unsigned int, (octave << LUT_OCTAVE_SHIFT) + (pos >> (FX_SHIFT - LUT_OCTAVE_SHIFT)), p->lut_len - 2);
+  if(i < LUT_DIRECT)
+    return p->Gain ? gain_head_fixed(p, speed, mode) : curve_cap_fixed(p, accel_curve_fixed(p, speed, mode));
+
+  pos = (pos << LUT_OCTAVE_SHIFT) & (FX_ONE - 1);
+  return curve_cap_fixed(p, p->lut_fx[i] + fx_mul(p->lut_fx[i + 1] - p->lut_fx[i], pos));
+}
+
+/* ########## Parameter publication */
+
+/* Builds a new parameter block from g_staging and publishes it.
+   Must be called with g_params_lock held, in process context.
+*/
+static int
+publish_params(void)
+{
+  struct accel_params *p, *old;
+
+  p = kmalloc(sizeof(*p), GFP_KERNEL);
+  if(!p)
+    return -ENOMEM;
+
+  kernel_fpu_begin();
+  memcpy(p, &g_staging, offsetof(struct accel_params, ref_ns));
+
+  p->ref_ns = (s64) p->ReferenceInterval * NSEC_PER_USEC;
+  p->window_ns = (s64) p->SpeedWindow * NSEC_PER_USEC;
+
+  PARAM_FX(p, SpeedCap);
+  PARAM_FX(p, Sensitivity);
+  PARAM_FX(p, Acceleration);
+  PARAM_FX(p, SensitivityCap);
+  PARAM_FX(p, Offset);
+  PARAM_FX(p, Exponent);
+  PARAM_FX(p, Midpoint);
+  PARAM_FX(p, OutputOffset);
+  PARAM_FX(p, ScrollsPerTick);
+
+  update_constants(p);
+  update_curve(p);
+  update_lut(p);
+
+  /* Linear without acceleration, at a sensitivity of 1. The offset would
+     still bend slow movements and any cap below 1 would scale them
   */
-  static float carry_x = 0.0f;
-  static float carry_y = 0.0f;
-  static float carry_whl = 0.0f;
-  static float last_ms = 1.0f;
-  static ktime_t last;
-  ktime_t now;
+  p->identity = p->AccelerationMode == 1 && p->Acceleration == 0 && p->Offset == 0
+    && p->Sensitivity == 1 && p->ScrollsPerTick == 3
+    && (p->SensitivityCap == 0 || p->SensitivityCap >= 1);
+  kernel_fpu_end();
+
+  select_kernel(p);
+
+  old = rcu_dereference_protected(g_params, lockdep_is_held(&g_params_lock));
+  rcu_assign_pointer(g_params, p);
+  if(old)
+    kfree_rcu(old, rcu);
+
+  return 0;
+}
+
+/* Bounds of the points of the custom curve. They keep the Q16.16 copies
+   of the fixed point engine in range
+*/
+#define CURVE_MAX_SPEED 0x49800000      /* 2^20 as float */
+#define CURVE_MAX_SENS 0x47000000       /* 2^15 as float */
+
+/* Replaces the points of the custom curve (AccelerationMode 4) and
+   publishes them. 'buf' holds (speed, sensitivity) pairs of floats.
+   The speeds have to increase strictly. Process context only.
+   An empty buffer removes the curve.
+*/
+int
+accel_set_curve(const void *buf, size_t len)
+{
+  unsigned int i, n = len / (2 * sizeof(u32));
+  u32 x, y, prev = 0;
+  int ret;
+
+  if(len % (2 * sizeof(u32)) || n == 1 || n > CURVE_POINTS)
+    return -EINVAL;
+
+  /* Validated on the bits, so no FPU is needed: For non-negative floats,
+     the order of the bits is the order of the values. The bounds also
+     rule out inf and NaN
+  */
+  for(i = 0; i < n; i++)
+    {
+      memcpy(&x, (const u32 *) buf + 2 * i, sizeof(x));
+      memcpy(&y, (const u32 *) buf + 2 * i + 1, sizeof(y));
+      if(x > CURVE_MAX_SPEED || y > CURVE_MAX_SENS || (i && x <= prev))
+        return -EINVAL;
+      prev = x;
+    }
+
+  mutex_lock(&g_params_lock);
+  for(i = 0; i < n; i++)
+    {
+      memcpy(&g_staging.curve_x[i], (const u32 *) buf + 2 * i, sizeof(u32));
+      memcpy(&g_staging.curve_y[i], (const u32 *) buf + 2 * i + 1, sizeof(u32));
+    }
+  g_staging.curve_len = n;
+  ret = publish_params();
+  mutex_unlock(&g_params_lock);
+
+  return ret;
+}
+
+/* Copies the points of the custom curve into 'buf' as written to
+   accel_set_curve(). Returns the number of bytes
+*/
+size_t
+accel_get_curve(void *buf, size_t len)
+{
+  unsigned int i;
+  size_t ret;
+
+  mutex_lock(&g_params_lock);
+  ret = min_t(size_t, len, g_staging.curve_len * 2 * sizeof(u32)) & ~(2 * sizeof(u32) - 1);
+  for(i = 0; i < ret / (2 * sizeof(u32)); i++)
+    {
+      memcpy((u32 *) buf + 2 * i, &g_staging.curve_x[i], sizeof(u32));
+      memcpy((u32 *) buf + 2 * i + 1, &g_staging.curve_y[i], sizeof(u32));
+    }
+  mutex_unlock(&g_params_lock);
+
+  return ret;
+}
+
+/* Publishes the initial parameters, unless some have already been written
+   while the module was loaded
+*/
+int
+accel_init(void)
+{
+  int ret = 0;
+
+  mutex_lock(&g_params_lock);
+  if(!rcu_access_pointer(g_params))
+    ret = publish_params();
+  mutex_unlock(&g_params_lock);
+
+  return ret;
+}
+
+void
+accel_exit(void)
+{
+  struct accel_params *p;
+
+  mutex_lock(&g_params_lock);
+  p = rcu_dereference_protected(g_params, lockdep_is_held(&g_params_lock));
+  RCU_INIT_POINTER(g_params, NULL);
+  mutex_unlock(&g_params_lock);
+
+  synchronize_rcu();
+  kfree(p);
+}
+
+/* ########## Acceleration code */
+
+/* Number of gaps the polling interval is seeded from */
+#define INTERVAL_SEED 16
+
+/* Resets the per-device state. Must be called once before the first accelerate() */
+void
+accel_init_state(struct accel_state *state)
+{
+  memset(state, 0, sizeof(*state));
+  state->interval = NSEC_PER_MSEC;
+  state->interval_seed = INTERVAL_SEED;
+  state->last_mult = FX_ONE;
+}
+
+/* Shortest plausible frametime (20 kHz). Anything below is considered bunched */
+#define FRAMETIME_MIN_NS (50 * NSEC_PER_USEC)
+
+/* Calculates the frametime in ns */
+INLINE s64
+frametime_ns(struct accel_state *state, ktime_t now)
+{
+  s64 ns = ktime_to_ns(ktime_sub(now, state->last));
+  state->last = now;
+
+  /* Original InterAccel has 200ms here.
+     RawAccel rounds to 100ms. So do we.
+  */
+  if(ns > 100 * NSEC_PER_MSEC) ns = 100 * NSEC_PER_MSEC;
+
+  /* Seeding: The polling interval starts as a guess of 1 ms. The gate
+     against bunching below would reject every gap of a mouse polling
+     faster than 4 kHz against it, so the guess would stick. Until
+     seeded, every plausible gap is taken and followed quickly (1/4).
+  */
+  if(state->interval_seed)
+    {
+      if(ns < FRAMETIME_MIN_NS)
+        return state->interval;
+      if(ns <= 16 * state->interval)
+        {
+          state->interval += (ns - state->interval) / 4;
+          state->interval_seed--;
+        }
+      return ns;
+    }
+
+  /* Sometimes, urbs appear bunched, so the timing reading is plain wrong.
+     Fallback to the smoothed polling interval in that case.
+   */
+  if(ns < FRAMETIME_MIN_NS || ns < state->interval / 4)
+    return state->interval;
+
+  /* Track the polling interval with an exponential moving average (1/8).
+     Pauses in the movement are no polling intervals and are left out.
+  */
+  if(ns <= 16 * state->interval)
+    state->interval += (ns - state->interval) / 8;
+
+  return ns;
+}
+
+/* Speed window: Adds the distance and frametime of a report and drops the
+   oldest reports, as long as the rest still covers the window. Returns the
+   distance and time of the whole window in 'dist' and 'ns'.
+   Every report is added and dropped once, so it costs O(1) on average.
+   After a pause, the new report covers the window on its own.
+*/
+INLINE void
+window_push(struct accel_state *state, s64 window_ns, s64 *dist, s64 *ns)
+{
+  unsigned int i;
+
+  if(state->window_len == SPEED_WINDOW_LEN)
+    {
+      state->window_sum_dist -= state->window_dist[state->window_head];
+      state->window_sum_ns -= state->window_ns[state->window_head];
+      state->window_head = (state->window_head + 1) & (SPEED_WINDOW_LEN - 1);
+      state->window_len--;
+    }
+
+  i = (state->window_head + state->window_len) & (SPEED_WINDOW_LEN - 1);
+  state->window_dist[i] = *dist;
+  state->window_ns[i] = (u32) *ns;
+  state->window_sum_dist += *dist;
+  state->window_sum_ns += *ns;
+  state->window_len++;
+
+  while(state->window_len > 1 && state->window_sum_ns - state->window_ns[state->window_head] >= window_ns)
+    {
+      state->window_sum_dist -= state->window_dist[state->window_head];
+      state->window_sum_ns -= state->window_ns[state->window_head];
+      state->window_head = (state->window_head + 1) & (SPEED_WINDOW_LEN - 1);
+      state->window_len--;
+    }
+
+  *dist = state->window_sum_dist;
+  *ns = state->window_sum_ns;
+}
+
+/* Empties the speed window */
+INLINE void
+window_reset(struct accel_state *state)
+{
+  state->window_head = 0;
+  state->window_len = 0;
+  state->window_sum_dist = 0;
+  state->window_sum_ns = 0;
+}
+
+/* Floating point engine. Instantiated per mode by KERNELS() */
+INLINE int
+accelerate_float(struct accel_state *state, struct accel_params *p, ktime_t now, int *x, int *y, int *wheel,
+                 const unsigned int mode)
+{
+  float delta_x, delta_y, delta_whl, ms, speed;
+  s64 dist, ns;
   int status = 0;
 
   /* We can only safely use the FPU in an IRQ event when this returns 1.
@@ -128,9 +1248,9 @@ accelerate(int *x, int *y, int *wheel)
   if(!irq_fpu_usable())
     {
       /* Buffer mouse deltas for next (valid) IRQ */
-      buffer_x += *x;
-      buffer_y += *y;
-      buffer_whl += *wheel;
+      state->buffer_x += *x;
+      state->buffer_y += *y;
+      state->buffer_whl += *wheel;
       return -EBUSY;
     }
 
@@ -151,7 +1271,6 @@ accelerate(int *x, int *y, int *wheel)
      Especially when playing certain videos in the browser.
   */
   kernel_fpu_begin();
-  accel_sens = g_Sensitivity;
 
   delta_x = (float) (*x);
   delta_y = (float) (*y);
@@ -170,9 +1289,9 @@ accelerate(int *x, int *y, int *wheel)
        && (int) delta_whl == *wheel))
     {
       /* Buffer mouse deltas for next (valid) IRQ */
-      buffer_x += *x;
-      buffer_y += *y;
-      buffer_whl += *wheel;
+      state->buffer_x += *x;
+      state->buffer_y += *y;
+      state->buffer_whl += *wheel;
       /* Jump out of kernel_fpu_begin */
       status = -EFAULT;
       printk("LEETMOUSE: First float-trap triggered."
@@ -181,87 +1300,62 @@ accelerate(int *x, int *y, int *wheel)
     }
 
   /* Add buffer values, if present, and reset buffer */
-  delta_x += (float) buffer_x;
-  delta_y += (float) buffer_y;
-  delta_whl += (float) buffer_whl;
-  buffer_x = 0;
-  buffer_y = 0;
-  buffer_whl = 0;
+  delta_x += (float) state->buffer_x;
+  delta_y += (float) state->buffer_y;
+  delta_whl += (float) state->buffer_whl;
+  state->buffer_x = 0;
+  state->buffer_y = 0;
+  state->buffer_whl = 0;
 
-  /* Calculate frametime */
-  now = ktime_get();
-  ms = (now - last) / (1000 * 1000);
-  last = now;
-  
-  /* Sometimes, urbs appear bunched -> Beyond µs resolution
-     so the timing reading is plain wrong. Fallback to
-     last known valid frametime
-   */
-  if(ms < 1) ms = last_ms;
-  
-  /* Original InterAccel has 200 here.
-     RawAccel rounds to 100. So do we.
+  /* Calculate frametime in units of the reference interval.
+     (It is at most 100ms, so it fits into an int)
   */
-  if(ms > 100) ms = 100;
-  last_ms = ms;
-
-  /* Update acceleration parameters periodically */
-  updata_params(now);
+  state->last_ns = frametime_ns(state, now);
+  ms = (float) (int) state->last_ns;
+  ms /= (float) (int) p->ref_ns;
 
   /* Get distance traveled */
   speed = delta_x * delta_x + delta_y * delta_y;
-  B_sqrt(&speed);
+  F_sqrt(&speed, p->Precision);
     
-  if (g_SpeedCap != 0 && speed >= g_SpeedCap)
-    speed = g_SpeedCap;
+  if (p->SpeedCap != 0 && speed >= p->SpeedCap)
+    speed = p->SpeedCap;
+
+  /* Average the speed over the window */
+  if(p->window_ns)
+    {
+      dist = (s64) (speed * FX_ONE);
+      ns = state->last_ns;
+      window_push(state, p->window_ns, &dist, &ns);
+      speed = (float) dist / FX_ONE;
+      ms = (float) (int) ns;
+      ms /= (float) (int) p->ref_ns;
+    }
+  else if(state->window_len)
+    window_reset(state);
 
   /* Calculate rate from travelled overall
      distance and add possible rate offsets
   */
   speed /= ms;
-  speed -= g_Offset;
+  speed -= p->Offset;
+  state->last_speed = (s64) (speed * FX_ONE);
 
-  /* Apply acceleration if movement is over offset */
-  if(speed > 0)
-    {
-      switch (g_AccelerationMode)
-        {
-        case 1: /* Linear acceleration */
-          // Speed * Acceleration
-          speed *= g_Acceleration;
-          speed += 1;
-          break;
-          
-        case 2: /* Classic acceleration */
-          /* (Speed * Acceleration)^Exponent */
-          speed *= g_Acceleration;
-          speed += 1;
-          B_pow(&speed, &g_Exponent);
-          break;
-          
-        case 3: /* Motivity (Sigmoid function) */
-          /* Acceleration / ( 1 + e ^ (midpoint - x)) */
-          product =  g_Midpoint-speed;
-          motivity = e;
-          B_pow(&motivity, &product);
-          motivity = g_Acceleration / (1 + motivity);
-          speed = motivity;
-          break;
-        }
-    }
+  speed = curve_lookup(p, speed, mode);
+  state->last_mult = (s64) (speed * FX_ONE);
 
   /* Apply acceleration */
   delta_x *= speed;
   delta_y *= speed;
 
   /* Like RawAccel, sensitivity will be a final multiplier: */
-  delta_x *= g_Sensitivity;
-  delta_y *= g_Sensitivity;
+  delta_x *= p->Sensitivity;
+  delta_y *= p->Sensitivity;
 
-  delta_x += carry_x;
-  delta_y += carry_y;
+  delta_x += state->carry_x;
+  delta_y += state->carry_y;
 
-  delta_whl *= g_ScrollsPerTick / 3.0f;
+  delta_whl *= p->ScrollsPerTick / 3.0f;
 
   /* Cast back to int */
   *x = Leet_round(&delta_x);
@@ -281,9 +1375,10 @@ accelerate(int *x, int *y, int *wheel)
   }
 
   /* Save carry for next round */
-  carry_x = delta_x - *x;
-  carry_y = delta_y - *y;
-  carry_whl = delta_whl - *wheel;
+  state->carry_x = delta_x - *x;
+  state->carry_y = delta_y - *y;
+  state->last_carry_x = (s64) (state->carry_x * FX_ONE);
+  state->last_carry_y = (s64) (state->carry_y * FX_ONE);
   
  exit:
   /* We stopped using the FPU: Switch back context again */
@@ -291,3 +1386,199 @@ accelerate(int *x, int *y, int *wheel)
 
   return status;
 }
+
+/* Fixed point engine.
+   Same algorithm as accelerate_float(), but entirely in Q16.16 integer
+   arithmetic (see fixed.h). Since it never touches the FPU, there is
+   no context switch and no need to defer the motion with -EBUSY.
+   Instantiated per mode by KERNELS()
+*/
+INLINE int
+accelerate_fixed(struct accel_state *state, struct accel_params *p, ktime_t now, int *x, int *y, int *wheel,
+                 const unsigned int mode)
+{
+  s64 delta_x, delta_y, delta_whl, speed, ns, rem;
+
+  /* Add buffer values, if present, and reset buffer */
+  delta_x = *x + state->buffer_x;
+  delta_y = *y + state->buffer_y;
+  delta_whl = *wheel + state->buffer_whl;
+  state->buffer_x = 0;
+  state->buffer_y = 0;
+  state->buffer_whl = 0;
+
+  /* Calculate frametime */
+  ns = frametime_ns(state, now);
+  state->last_ns = ns;
+
+  /* Get distance traveled */
+  speed = fx_hypot(delta_x, delta_y);
+
+  if (p->fx_SpeedCap != 0 && speed >= p->fx_SpeedCap)
+    speed = p->fx_SpeedCap;
+
+  /* Average the speed over the window */
+  if(p->window_ns)
+    window_push(state, p->window_ns, &speed, &ns);
+  else if(state->window_len)
+    window_reset(state);
+
+  /* Calculate rate from travelled overall
+     distance and add possible rate offsets.
+     Divides first: The distance of a full window times ReferenceInterval
+     can exceed s64. The remainder is below ns, which is at most a window
+     plus a frametime, so its product cannot.
+  */
+  rem = speed;
+  speed = div64_s64(speed, ns);
+  rem -= speed * ns;
+  speed = speed * p->ref_ns + div64_s64(rem * p->ref_ns, ns);
+  speed -= p->fx_Offset;
+  state->last_speed = speed;
+
+  speed = curve_lookup_fixed(p, speed, mode);
+  state->last_mult = speed;
+
+  /* Apply acceleration and sensitivity. The deltas become Q16.16 here */
+  delta_x = fx_mul(delta_x * speed, p->fx_Sensitivity) + state->fx_carry_x;
+  delta_y = fx_mul(delta_y * speed, p->fx_Sensitivity) + state->fx_carry_y;
+
+  delta_whl = delta_whl * p->fx_ScrollsPerTick / 3;
+
+  *x = fx_round(delta_x);
+  *y = fx_round(delta_y);
+  *wheel = fx_round(delta_whl);
+
+  /* Save carry for next round */
+  state->fx_carry_x = delta_x - FX_FROM_INT(*x);
+  state->fx_carry_y = delta_y - FX_FROM_INT(*y);
+  state->last_carry_x = state->fx_carry_x;
+  state->last_carry_y = state->fx_carry_y;
+
+  return 0;
+}
+
+/* Passthrough: Neither sensitivity nor acceleration change the motion.
+   No FPU, no curve, only the buffered motion is added
+*/
+static int
+accelerate_passthrough(struct accel_state *state, struct accel_params *p, ktime_t now, int *x, int *y, int *wheel)
+{
+  *x += state->buffer_x;
+  *y += state->buffer_y;
+  *wheel += state->buffer_whl;
+  state->buffer_x = 0;
+  state->buffer_y = 0;
+  state->buffer_whl = 0;
+
+  /* Nothing to carry over, but keep the frametime tracked for a switch back */
+  state->last_ns = frametime_ns(state, now);
+  state->last_speed = 0;
+  state->last_mult = FX_ONE;
+  state->carry_x = 0;
+  state->carry_y = 0;
+  state->fx_carry_x = 0;
+  state->fx_carry_y = 0;
+  state->last_carry_x = 0;
+  state->last_carry_y = 0;
+  window_reset(state);
+
+  return 0;
+}
+
+/* ########## Kernels */
+
+/* Every mode gets its own fully inlined copy of both engines, with the
+   mode as a constant. publish_params() picks the kernel of the block, so
+   a report does not branch on the mode at all.
+*/
+#define KERNELS(mode)                                                   \
+  static int                                                            \
+  accelerate_float_##mode(struct accel_state *state, struct accel_params *p, \
+                          ktime_t now, int *x, int *y, int *wheel)      \
+  {                                                                     \
+    return accelerate_float(state, p, now, x, y, wheel, mode);          \
+  }                                                                     \
+  static int                                                            \
+  accelerate_fixed_##mode(struct accel_state *state, struct accel_params *p, \
+                          ktime_t now, int *x, int *y, int *wheel)      \
+  {                                                                     \
+    return accelerate_fixed(state, p, now, x, y, wheel, mode);          \
+  }
+
+KERNELS(1)
+KERNELS(2)
+KERNELS(3)
+KERNELS(4)
+KERNELS(5)
+KERNELS(6)
+KERNELS(7)
+KERNELS(8)
+
+static const accel_kernel g_float_kernels[] = {
+  [1] = accelerate_float_1, [2] = accelerate_float_2, [3] = accelerate_float_3, [4] = accelerate_float_4,
+  [5] = accelerate_float_5, [6] = accelerate_float_6, [7] = accelerate_float_7, [8] = accelerate_float_8,
+};
+
+static const accel_kernel g_fixed_kernels[] = {
+  [1] = accelerate_fixed_1, [2] = accelerate_fixed_2, [3] = accelerate_fixed_3, [4] = accelerate_fixed_4,
+  [5] = accelerate_fixed_5, [6] = accelerate_fixed_6, [7] = accelerate_fixed_7, [8] = accelerate_fixed_8,
+};
+
+static void
+select_kernel(struct accel_params *p)
+{
+  if(p->identity)
+    p->kernel = accelerate_passthrough;
+  else if(p->FixedPoint)
+    p->kernel = g_fixed_kernels[p->AccelerationMode];
+  else
+    p->kernel = g_float_kernels[p->AccelerationMode];
+}
+
+/* Acceleration happens here */
+int
+accelerate(struct accel_state *state, ktime_t now, int *x, int *y, int *wheel)
+{
+  struct accel_params *p;
+  int status = -ENODEV;
+
+  rcu_read_lock();
+  p = rcu_dereference(g_params);
+  if(p)
+    status = p->kernel(state, p, now, x, y, wheel);
+  rcu_read_unlock();
+
+  return status;
+}
+
+/* Emits the motion buffered by accelerate(), when no report followed to
+   pick it up (see report_flush() in report.c). It takes the multiplier of
+   the last report in Q16.16, so it never needs the FPU. It is no report of
+   its own: The frametime, the speed window and the carry stay untouched,
+   and the sub-count remainder of the flushed motion is dropped.
+*/
+int
+accel_flush(struct accel_state *state, int *x, int *y, int *wheel)
+{
+  struct accel_params *p;
+  s64 mult;
+  int status = -ENODEV;
+
+  rcu_read_lock();
+  p = rcu_dereference(g_params);
+  if(p)
+    {
+      mult = fx_mul(state->last_mult, p->fx_Sensitivity);
+      *x = fx_round(state->buffer_x * mult);
+      *y = fx_round(state->buffer_y * mult);
+      *wheel = fx_round(state->buffer_whl * p->fx_ScrollsPerTick / 3);
+      state->buffer_x = 0;
+      state->buffer_y = 0;
+      state->buffer_whl = 0;
+      status = 0;
+    }
+  rcu_read_unlock();
+
+  return status;
+}
@@ -1,6 +1,65 @@
 #ifndef _ACCEL_H
 #define _ACCEL_H
 
-int accelerate(int *x, int *y, int *wheel);
+#include <linux/types.h>
+#include <linux/ktime.h>
+#include <linux/cache.h>
+
+/* Most reports in the speed window (see SpeedWindow). A power of 2 */
+#define SPEED_WINDOW_LEN 128
+
+/* Acceleration state of a single device. Every mouse gets its own,
+   so the carry and frametime of one device never leak into another one.
+   Cache-line aligned, so two mice firing their IRQs on different CPUs
+   do not bounce a shared cache line.
+   Note: The float members may only be accessed within
+   kernel_fpu_begin()/kernel_fpu_end() (see accel.c)
+*/
+struct accel_state {
+    /* Motion, which could not be processed yet. Shared by both engines,
+       so switching between them does not loose any counts */
+    long buffer_x;
+    long buffer_y;
+    long buffer_whl;
+
+    /* Frametime */
+    ktime_t last;                       /* Timestamp of the last report */
+    s64 interval;                       /* Smoothed polling interval in ns */
+    unsigned int interval_seed;         /* Gaps left, until the polling interval is seeded */
+
+    /* Sub-count remainders of the float and fixed point engine */
+    float carry_x;
+    float carry_y;
+    s64 fx_carry_x;
+    s64 fx_carry_y;
+
+    /* Speed window: Distance (Q16.16) and frametime (ns) of the last
+       reports as a ring, with running sums over it */
+    s64 window_dist[SPEED_WINDOW_LEN];
+    u32 window_ns[SPEED_WINDOW_LEN];
+    unsigned int window_head;
+    unsigned int window_len;
+    s64 window_sum_dist;
+    s64 window_sum_ns;
+
+    /* Outcome of the last accelerate() for the tracepoints (see trace.h).
+       Q16.16, so they can be read outside of the FPU sections */
+    s64 last_ns;                        /* Frametime */
+    s64 last_speed;                     /* Speed fed into the curve */
+    s64 last_mult;                      /* Multiplier the curve returned */
+    s64 last_carry_x;
+    s64 last_carry_y;
+} ____cacheline_aligned;
+
+/* Most points of the custom curve (AccelerationMode 4) */
+#define CURVE_POINTS 256
+
+int accel_init(void);
+void accel_exit(void);
+int accel_set_curve(const void *buf, size_t len);
+size_t accel_get_curve(void *buf, size_t len);
+void accel_init_state(struct accel_state *state);
+int accelerate(struct accel_state *state, ktime_t now, int *x, int *y, int *wheel);
+int accel_flush(struct accel_state *state, int *x, int *y, int *wheel);
 
 #endif /* _ACCEL_H */
@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "capture.h"
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/miscdevice.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/kref.h>
+#include <linux/idr.h>
+
+// The capture device may outlive its mouse: An open file keeps the struct capture alive, until it gets closed
+struct capture {
+    struct kref ref;
+    struct miscdevice misc;
+    char name[32];
+    int id;
+    bool gone;                                  // The mouse is gone
+    atomic_t open;
+    struct capture_ring __rcu *ring;
+    wait_queue_head_t wait;
+};
+
+static DEFINE_IDA(capture_ida);
+
+static void capture_free(struct kref *ref)
+{
+    struct capture *cap = container_of(ref, struct capture, ref);
+
+    ida_free(&capture_ida, cap->id);
+    kfree(cap);
+}
+
+struct capture_ring *capture_ring(struct capture *cap)
+{
+    return rcu_dereference_check(cap->ring, rcu_read_lock_any_held());
+}
+
+void capture_commit(struct capture *cap, struct capture_ring *ring)
+{
+    ring->head++;
+    smp_store_release(&ring->hdr->head, ring->head);
+
+    //A reader only sleeps, once it consumed everything. Anything else runs without a single wakeup
+    if (wq_has_sleeper(&cap->wait))
+        wake_up_interruptible(&cap->wait);
+}
+
+static int capture_open(struct inode *inode, struct file *file)
+{
+    struct capture *cap = container_of(file->private_data, struct capture, misc);
+    struct capture_ring *ring;
+
+    //Single consumer
+    if (atomic_cmpxchg(&cap->open, 0, 1))
+        return -EBUSY;
+
+    ring = kzalloc(sizeof(*ring), GFP_KERNEL);
+    if (!ring)
+        goto fail;
+    ring->hdr = vmalloc_user(LEETMOUSE_CAPTURE_MMAP_SIZE);
+    if (!ring->hdr) {
+        kfree(ring);
+        goto fail;
+    }
+    ring->rec = (void *) ring->hdr + LEETMOUSE_CAPTURE_DATA_OFFSET;
+    ring->hdr->version = LEETMOUSE_CAPTURE_VERSION;
+    ring->hdr->record_size = sizeof(struct leetmouse_capture_record);
+    ring->hdr->records = LEETMOUSE_CAPTURE_RECORDS;
+    ring->hdr->data_offset = LEETMOUSE_CAPTURE_DATA_OFFSET;
+
+    kref_get(&cap->ref);
+    file->private_data = cap;
+    rcu_assign_pointer(cap->ring, ring);
+    return nonseekable_open(inode, file);
+
+fail:
+    atomic_set(&cap->open, 0);
+    return -ENOMEM;
+}
+
+static int capture_release(struct inode *inode, struct file *file)
+{
+    struct capture *cap = file->private_data;
+    struct capture_ring *ring = rcu_dereference_protected(cap->ring, 1);
+
+    //Wait for the producer to leave the ring. Since there is no mapping left either (it holds the file), it can go away then
+    RCU_INIT_POINTER(cap->ring, NULL);
+    synchronize_rcu();
+    vfree(ring->hdr);
+    kfree(ring);
+
+    atomic_set(&cap->open, 0);
+    kref_put(&cap->ref, capture_free);
+    return 0;
+}
+
+static int capture_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    struct capture *cap = file->private_data;
+    struct capture_ring *ring = rcu_dereference_protected(cap->ring, 1);
+
+    return remap_vmalloc_range(vma, ring->hdr, vma->vm_pgoff);
+}
+
+static __poll_t capture_poll(struct file *file, poll_table *wait)
+{
+    struct capture *cap = file->private_data;
+    struct capture_ring *ring = rcu_dereference_protected(cap->ring, 1);
+
+    poll_wait(file, &cap->wait, wait);
+    if (smp_load_acquire(&ring->hdr->head) != READ_ONCE(ring->hdr->tail))
+        return EPOLLIN | EPOLLRDNORM;
+    if (READ_ONCE(cap->gone))
+        return EPOLLHUP;
+    return 0;
+}
+
+static const struct file_operations capture_fops = {
+    .owner   = THIS_MODULE,
+    .open    = capture_open,
+    .release = capture_release,
+    .mmap    = capture_mmap,
+    .poll    = capture_poll,
+};
+
+struct capture *capture_create(struct device *parent)
+{
+    struct capture *cap;
+    int ret;
+
+    cap = kzalloc(sizeof(*cap), GFP_KERNEL);
+    if (!cap)
+        return ERR_PTR(-ENOMEM);
+
+    cap->id = ida_alloc(&capture_ida, GFP_KERNEL);
+    if (cap->id < 0) {
+        ret = cap->id;
+        kfree(cap);
+        return ERR_PTR(ret);
+    }
+    kref_init(&cap->ref);
+    init_waitqueue_head(&cap->wait);
+    snprintf(cap->name, sizeof(cap->name), "leetmouse-cap%d", cap->id);
+
+    cap->misc.minor = MISC_DYNAMIC_MINOR;
+    cap->misc.name = cap->name;
+    cap->misc.fops = &capture_fops;
+    cap->misc.parent = parent;
+    cap->misc.mode = 0600;
+
+    ret = misc_register(&cap->misc);
+    if (ret) {
+        kref_put(&cap->ref, capture_free);
+        return ERR_PTR(ret);
+    }
+    return cap;
+}
+
+void capture_destroy(struct capture *cap)
+{
+    misc_deregister(&cap->misc);
+    WRITE_ONCE(cap->gone, true);
+    wake_up_interruptible(&cap->wait);
+    kref_put(&cap->ref, capture_free);
+}
@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef _CAPTURE_H
+#define _CAPTURE_H
+
+#include "leetmouse_uapi.h"
+#include <linux/types.h>
+#include <linux/rcupdate.h>
+
+// Capture ring of a device (see leetmouse_uapi.h for the layout and how to read it)
+// The ring only exists, while the capture device is open. The device side is the only producer: It reserves a record, fills it and commits it.
+// Neither of that allocates or locks. Producing must happen within an RCU read side section (e.g. with interrupts disabled), which keeps the ring alive.
+
+struct capture_ring {
+    struct leetmouse_capture_header *hdr;
+    struct leetmouse_capture_record *rec;
+    u64 head;                                   // The producer's copy. The one in the mapping is only written, never read back
+};
+
+struct capture;
+
+// Registers the capture device of a device. 'parent' becomes the device it points to in sysfs
+struct capture *capture_create(struct device *parent);
+// Unregisters the capture device. A reader still holding it open keeps its mapping, but no more records arrive
+void capture_destroy(struct capture *cap);
+
+struct capture_ring *capture_ring(struct capture *cap);
+
+// Next free record or NULL, if nobody reads or the ring is full
+static inline struct leetmouse_capture_record *capture_reserve(struct capture_ring *ring)
+{
+    u64 tail;
+
+    if (!ring)
+        return NULL;
+    tail = READ_ONCE(ring->hdr->tail);
+    //The tail comes from userspace. Anything out of range counts as a full ring
+    if (ring->head - tail >= LEETMOUSE_CAPTURE_RECORDS) {
+        WRITE_ONCE(ring->hdr->dropped, ring->hdr->dropped + 1);
+        return NULL;
+    }
+    return &ring->rec[ring->head & (LEETMOUSE_CAPTURE_RECORDS - 1)];
+}
+
+void capture_commit(struct capture *cap, struct capture_ring *ring);
+
+#endif  //_CAPTURE_H
@@ -0,0 +1,99 @@
+/* Minimum size of the report buffer in bytes.
+   The buffer is sized from the endpoint's packet size and the largest
+   report of the report descriptor when the mouse is bound. If a mouse
+   still overflows it, the buffer is grown once at runtime.
+*/
+#define BUFFER_SIZE 16
+
+/* Number of interrupt URBs kept in flight per mouse (1 to 4).
+   With more than one, the host controller can keep polling the mouse
+   while a report is still being processed. Helps to not miss a single
+   report at high polling rates (4-8 kHz). Module parameter: urbs
+*/
+#define URB_QUEUE 2
+
+/* Polling interval in microseconds, overriding the one requested by the mouse.
+   0 keeps the mouse's own. Limited to 1000-255000 for low and full speed
+   mice and 125-4096000 for high speed mice. Module parameter: interval
+*/
+#define POLL_INTERVAL 0
+
+/* When the FPU cannot be used in the IRQ, the motion of a report gets
+   deferred. Unless another report arrives before, it is emitted after
+   this many microseconds.
+*/
+#define FLUSH_DELAY 250
+
+/* This should be your desired acceleration. It needs to end with an f.
+   For example, setting this to "0.1f" should be equal to
+   cl_mouseaccel 0.1 in Quake.
+*/
+
+/* Changes behaviour of the scroll-wheel. Default is 3.0f */
+#define SCROLLS_PER_TICK 3.0f
+
+/* Accel configuration */
+#define SENSITIVITY 1.0f
+#define ACCELERATION 0.04f
+#define SENS_CAP 2.2f
+#define OFFSET 0.0f
+#define SPEED_CAP 0.0f
+#define MIDPOINT 1.0f
+#define EXPONENT 0.0f
+#define OUTPUT_OFFSET 0.0f
+#define SMOOTHNESS 0.5f
+
+/* 1 = linear, 2 = classic, 3 = motivity, 4 = custom curve,
+   5 = power, 6 = natural, 7 = jump, 8 = synchronous.
+   The custom curve is a monotone cubic spline through up to 256
+   (speed, sensitivity) points, written as pairs of floats to
+   /sys/module/leetmouse/CurvePoints at runtime.
+   Power:       (Speed * ACCELERATION)^EXPONENT + OUTPUT_OFFSET
+   Natural:     Approaches SENS_CAP at the rate ACCELERATION
+   Jump:        Steps from 1 to ACCELERATION at the speed MIDPOINT,
+                smoothed by SMOOTHNESS
+   Synchronous: Motivity ACCELERATION, gamma EXPONENT, synchronous
+                speed MIDPOINT and SMOOTHNESS, like RawAccel
+   SENS_CAP caps the sensitivity of all modes. 0 disables it.
+*/
+#define ACCELERATION_MODE 1
+
+/* Set this to 1 to take the curve as the gain instead of the sensitivity:
+   The curve then is the slope of the output speed over the input speed,
+   like RawAccel's gain mode. The sensitivity follows the average of the
+   curve, so it never jumps. Needs the curve cache, see LUT_SIZE.
+*/
+#define GAIN 0
+
+/* Precision of the float math used by the curves:
+   0 = fast (Blinn's approximations), 1 = balanced, 2 = exact
+*/
+#define PRECISION 1
+
+/* Time base of all speeds in µs. The default of 1000 measures
+   speeds in counts per ms, independent of the polling rate.
+*/
+#define REFERENCE_INTERVAL 1000
+
+/* Time in µs the speed is averaged over, e.g. 1000-4000. At high polling
+   rates, a single report only carries 1-2 counts, so its speed alone is
+   very coarse and the sensitivity jitters from report to report.
+   At most the last 128 reports are taken. 0 disables the window.
+*/
+#define SPEED_WINDOW 0
+
+/* Curve cache: The acceleration curve is sampled into a table of LUT_SIZE
+   entries for speeds up to LUT_RANGE (counts per ms). The entries are
+   densest at low speeds: Evenly spaced up to about LUT_RANGE / 250 and
+   32 per doubling of the speed above. Each entry costs
+   12 bytes. Both can be lowered at runtime via the LutSize and LutRange
+   parameters. Setting LutSize to 0 evaluates the curve for every report.
+*/
+#define LUT_SIZE 256
+#define LUT_RANGE 200.0f
+
+/* Set this to 1 to use the integer (fixed point) acceleration engine.
+   It never touches the FPU and thus never has to defer motion until
+   the next report, when the FPU is not available in the IRQ.
+*/
+#define FIXED_POINT 0
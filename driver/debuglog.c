@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "debuglog.h"
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+// Output: One line per report: Timestamp (ns), length of the report and its first DEBUGLOG_DATA bytes
+//     1234567890123 8: 01 00 fd ff ff 00 00 00
+
+void debuglog_write(struct debuglog *log, ktime_t now, const unsigned char *data, int len)
+{
+    struct debuglog_record *r;
+    u32 head = log->head;
+
+    if (ktime_to_ns(ktime_sub(now, log->window)) >= NSEC_PER_SEC) {
+        log->window = now;
+        log->in_window = 0;
+    }
+    if (log->in_window >= DEBUGLOG_RATE) {
+        WRITE_ONCE(log->dropped, log->dropped + 1);
+        return;
+    }
+    log->in_window++;
+
+    r = &log->rec[head & (DEBUGLOG_SIZE - 1)];
+    WRITE_ONCE(r->seq, 0);
+    smp_wmb();
+    r->time = now;
+    r->len = len;
+    memcpy(r->data, data, min_t(int, len, DEBUGLOG_DATA));
+    smp_wmb();
+    WRITE_ONCE(r->seq, head + 1);
+    smp_store_release(&log->head, head + 1);
+}
+
+static int debuglog_show(struct seq_file *m, void *unused)
+{
+    struct debuglog *log = m->private;
+    struct debuglog_record r;
+    u32 head = smp_load_acquire(&log->head);
+    u32 i = head > DEBUGLOG_SIZE ? head - DEBUGLOG_SIZE : 0;
+    u32 seq;
+    int n;
+
+    seq_printf(m, "# %u logged, %u dropped by the rate limit\n", head, READ_ONCE(log->dropped));
+    for (; i != head; i++) {
+        struct debuglog_record *src = &log->rec[i & (DEBUGLOG_SIZE - 1)];
+
+        //Skip records, which the device is overwriting right now
+        seq = READ_ONCE(src->seq);
+        smp_rmb();
+        memcpy(&r, src, sizeof(r));
+        smp_rmb();
+        if (seq != i + 1 || READ_ONCE(src->seq) != seq)
+            continue;
+
+        seq_printf(m, "%lld %u:", ktime_to_ns(r.time), r.len);
+        for (n = 0; n < min_t(int, r.len, DEBUGLOG_DATA); n++)
+            seq_printf(m, " %02x", r.data[n]);
+        seq_putc(m, '\n');
+    }
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(debuglog);
+
+int debuglog_create(struct debuglog *log, struct dentry *dir)
+{
+    memset(log, 0, sizeof(*log));
+    log->rec = kcalloc(DEBUGLOG_SIZE, sizeof(*log->rec), GFP_KERNEL);
+    if (!log->rec)
+        return -ENOMEM;
+
+    debugfs_create_file("log", 0444, dir, log, &debuglog_fops);
+    return 0;
+}
+
+void debuglog_destroy(struct debuglog *log)
+{
+    kfree(log->rec);
+    log->rec = NULL;
+}
@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef _DEBUGLOG_H
+#define _DEBUGLOG_H
+
+#include <linux/types.h>
+#include <linux/ktime.h>
+
+// Raw reports of a device, logged while the module parameter 'debug' is on. Readable via debugfs: /sys/kernel/debug/leetmouse/<device>/log
+// Instead of the console, the reports go into a ring buffer per device, which keeps the last DEBUGLOG_SIZE of them.
+// Logging is lockless: The device is the only writer, readers detect records being overwritten while they copy them.
+// At most DEBUGLOG_RATE reports per second are logged, the rest is counted as dropped.
+
+#define DEBUGLOG_SIZE 256                   // Records, power of 2
+#define DEBUGLOG_DATA 16                    // Bytes of a report kept
+#define DEBUGLOG_RATE 1000
+
+struct dentry;
+
+struct debuglog_record {
+    u32 seq;                                // Position in the log + 1. 0, while the record is written
+    u16 len;                                // Length of the whole report
+    u8 data[DEBUGLOG_DATA];
+    ktime_t time;
+};
+
+struct debuglog {
+    struct debuglog_record *rec;
+    u32 head;                               // Records written so far
+    ktime_t window;                         // Rate limit: Start of the current second and the records logged within
+    u32 in_window;
+    u32 dropped;
+};
+
+// Allocates the log and exposes it as 'log' in the debugfs directory 'dir'
+int debuglog_create(struct debuglog *log, struct dentry *dir);
+void debuglog_destroy(struct debuglog *log);
+
+void debuglog_write(struct debuglog *log, ktime_t now, const unsigned char *data, int len);
+
+#endif  //_DEBUGLOG_H
@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef _FIXED_H
+#define _FIXED_H
+
+#include "util.h"
+#include <linux/kernel.h>
+#include <linux/math64.h>
+
+// Fixed point arithmetic. The integer counterpart to float.h, used by the fixed point acceleration engine in accel.c
+// All values are signed Q16.16 numbers stored in a s64, so intermediate products of two values cannot overflow for the value ranges of a mouse.
+// Nothing in here touches the FPU, so it is safe to be used anywhere without kernel_fpu_begin() / kernel_fpu_end().
+
+#define FX_SHIFT 16
+#define FX_ONE (1ll << FX_SHIFT)
+#define FX_HALF (1ll << (FX_SHIFT - 1))
+#define FX_MAX_EXP2 40                              // Largest integer exponent fx_exp2 accepts before saturating. 2^40 in Q16.16 still fits into a s64
+
+// Converts an integer to fixed point
+#define FX_FROM_INT(i) (((s64) (i)) << FX_SHIFT)
+
+// log2(e) in Q16.16
+#define FX_LOG2_E 94548ll
+
+// Multiplication and division of two Q16.16 numbers
+static INLINE s64 fx_mul(s64 a, s64 b)
+{
+    return (a * b) >> FX_SHIFT;
+}
+
+static INLINE s64 fx_div(s64 a, s64 b)
+{
+    if(!b) return 0;
+    return div64_s64(a << FX_SHIFT, b);
+}
+
+// Rounds (up/down) depending on sign. Same behaviour as Leet_round() in float.h
+static INLINE int fx_round(s64 x)
+{
+    if (x >= 0) {
+        return (int) ((x + FX_HALF) >> FX_SHIFT);
+    } else {
+        return (int) -((-x + FX_HALF) >> FX_SHIFT);
+    }
+}
+
+// Integer square root of a 64 bit number (digit by digit, rounded down)
+static INLINE u64 fx_isqrt64(u64 n)
+{
+    u64 res = 0, bit = 1ull << 62;
+
+    while(bit > n) bit >>= 2;
+    while(bit){
+        if(n >= res + bit){
+            n -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return res;
+}
+
+// Euclidean length of an integer vector, returned in Q16.16
+static INLINE s64 fx_hypot(s64 x, s64 y)
+{
+    u64 n = (u64) (x*x) + (u64) (y*y);
+
+    //Shifting into Q32.32 before taking the root yields a Q16.16 result. Large vectors loose the fractional bits instead of overflowing
+    if(n < (1ull << 31))
+        return (s64) fx_isqrt64(n << (2*FX_SHIFT));
+    return (s64) fx_isqrt64(n) << FX_SHIFT;
+}
+
+// log base 2: log_2(x) for x > 0
+// The fractional part is calculated bit by bit by repeated squaring of the normalized mantissa in Q2.30
+static INLINE s64 fx_log2(s64 x)
+{
+    s64 result = 0;
+    u64 z;
+    int i;
+
+    if(x <= 0) return -FX_FROM_INT(FX_MAX_EXP2);
+
+    //Normalize x to [1,2)
+    while(x >= 2*FX_ONE){
+        x >>= 1;
+        result += FX_ONE;
+    }
+    while(x < FX_ONE){
+        x <<= 1;
+        result -= FX_ONE;
+    }
+
+    z = (u64) x << (30 - FX_SHIFT);
+    for(i = 1; i <= FX_SHIFT; i++){
+        z = (z * z) >> 30;
+        if(z >= (2ull << 30)){
+            z >>= 1;
+            result += FX_ONE >> i;
+        }
+    }
+    return result;
+}
+
+// 2^(2^-k) for k = 1..16 in Q2.30
+static const u32 fx_exp2_table[FX_SHIFT] = {
+    0x5a82799a, 0x4c1bf829, 0x45cae0f2, 0x42d561b4, 0x4166c34c, 0x40b268fa, 0x4058f6a8, 0x402c6be9,
+    0x4016321b, 0x400b1818, 0x40058bce, 0x4002c5d8, 0x400162e8, 0x4000b173, 0x400058b9, 0x40002c5d
+};
+
+// exp base 2: 2^x
+// The fractional part is assembled from the product of the powers 2^(2^-k) of all bits set in it
+static INLINE s64 fx_exp2(s64 x)
+{
+    s64 ipart = x >> FX_SHIFT;                      // Arithmetic shift: Rounds towards -infinity, so the fractional part is always positive
+    u64 frac = x & (FX_ONE - 1);
+    u64 r = 1ull << 30;
+    int i;
+
+    if(ipart >= FX_MAX_EXP2) return FX_FROM_INT(1ll << FX_MAX_EXP2);
+    if(ipart < -FX_SHIFT) return 0;
+
+    for(i = 0; i < FX_SHIFT; i++)
+        if(frac & (1ull << (FX_SHIFT - 1 - i)))
+            r = (r * fx_exp2_table[i]) >> 30;
+
+    r >>= 30 - FX_SHIFT;
+    return ipart >= 0 ? (s64) (r << ipart) : (s64) (r >> -ipart);
+}
+
+// exp base e: e^x
+static INLINE s64 fx_exp(s64 x)
+{
+    return fx_exp2(fx_mul(x, FX_LOG2_E));
+}
+
+// power: x^p for x > 0
+static INLINE s64 fx_pow(s64 x, s64 p)
+{
+    return fx_exp2(fx_mul(p, fx_log2(x)));
+}
+
+#endif // _FIXED_H
@@ -24,7 +24,7 @@ static INLINE int atof(const char *str, int len, float *result)
     for(i = 0; i < len; i++){
         c = str[i];
         if(c == ' ') continue;              //Skip any white space
-        if(c == 0 && c == 'f') break;       //End of str or end of valid input
+        if(c == 0 || c == 'f') break;       //End of str or end of valid input
         if(c == '-'){                       //Sign found
             if(!sign){
                 sign = -1;
@@ -82,7 +82,7 @@ static const float ScaleDwn = 1.0f/ScaleUp;
 //log base 2: log_2(f)
 static INLINE void B_log2(float *f)
 {
-    *f = (float) (ASINT(f) - OneAsInt)*ScaleDwn;
+    *f = (float) (int) (ASINT(f) - OneAsInt)*ScaleDwn;
 }
 
 //exp base 2: 2^f
@@ -111,7 +111,7 @@ static INLINE void B_exp(float *f)
 //This comes from basically using two approximations combined (B_log2 and B_exp2) here.
 static INLINE void B_pow(float *f, float *p)
 {
-    int x = (int) ((*p)*(ASINT(f) - OneAsInt)) + OneAsInt;
+    int x = (int) ((*p)*(int) (ASINT(f) - OneAsInt)) + OneAsInt;
     *f = ASFLOAT(&x);
 }
 
@@ -125,6 +125,191 @@ static INLINE void B_sqrt(float *f)
     *f = (y*y + *f)/(2*y);                          // 1st iteration
 }
 
+// ########## Minimax polynomial kernels
+// Blinn's tricks above approximate the whole function linearly between two powers of two.
+// The kernels below only use the bit tricks for splitting a float into its exponent and mantissa and
+// approximate the function on the remaining small mantissa interval with a minimax polynomial (coefficients found with the Remez algorithm).
+// All of them are inline and branch-light, so they are safe within kernel_fpu_begin() / kernel_fpu_end().
+// The precision tiers:
+//   PRECISION_FAST:      Blinn's tricks from above
+//   PRECISION_BALANCED:  Relative error of the polynomials of log2 < 5e-5 and of exp2 < 7.5e-5
+//   PRECISION_EXACT:     Within 1 ulp for log2, exp2, sqrt and pow: The kernels further below evaluate in double precision and only round the result to float.
+//                        pow() in particular needs it: p*log_2(f) scales the error of log_2(f) by up to |p*log_2(f)|, which cost up to 20 ulp in float.
+// The measured error and cost of each tier can be reported with debug/float_bench (make float_bench).
+enum float_precision {
+    PRECISION_FAST = 0,
+    PRECISION_BALANCED = 1,
+    PRECISION_EXACT = 2
+};
+
+static const unsigned int SqrtTwoAsInt = 0x3FB504F3;   //sqrt(2) as int
+static const unsigned int MinNormAsInt = 0x00800000;   //Smallest normalized float as int
+
+//log base 2: log_2(f)
+//f = 2^e * (1 + t) with (1 + t) in [sqrt(0.5), sqrt(2)) and log_2(1 + t) = t * P(t)
+static INLINE void P_log2(float *f)
+{
+    unsigned int x = ASINT(f);
+    float t, p;
+    int e;
+
+    //Zero, denormals and negative numbers
+    if(x < MinNormAsInt || x >= 0x80000000){
+        *f = -126.0f;
+        return;
+    }
+
+    e = (int) (x >> 23) - 127;
+    x = (x & 0x007FFFFF) | OneAsInt;                //Mantissa in [1, 2)
+    if(x >= SqrtTwoAsInt){                          //Mantissa in [sqrt(0.5), sqrt(2))
+        x -= 0x00800000;
+        e++;
+    }
+    t = ASFLOAT(&x) - 1.0f;
+
+    p = 1.442646251e+00f + t*(-7.205549723e-01f + t*(4.853065147e-01f + t*(-3.908924424e-01f + t*2.547518723e-01f)));
+
+    *f = (float) e + t*p;
+}
+
+//exp base 2: 2^f
+//f = i + x with integer i and x in [-0.5, 0.5] and 2^x = P(x)
+static INLINE void P_exp2(float *f)
+{
+    float x = *f, p;
+    unsigned int r;
+    int i;
+
+    //Stay within normalized floats
+    if(x > 127.0f) x = 127.0f;
+    if(x < -125.0f) x = -125.0f;
+
+    i = (int) (x >= 0 ? x + 0.5f : x - 0.5f);      //Round to nearest
+    x -= (float) i;
+
+    p = 9.999280735e-01f + x*(6.932609855e-01f + x*(2.426111222e-01f + x*5.517166907e-02f));
+
+    r = ASINT(&p) + ((unsigned int) i << 23);      //Multiply by 2^i
+    *f = ASFLOAT(&r);
+}
+
+// ########## Double precision kernels (PRECISION_EXACT)
+// Same range reduction as above, but the series are evaluated in double. Their error (< 1e-12) stays far below the final rounding to float,
+// which is what leaves at most 1 ulp. The coefficients are plain Taylor coefficients: The reduced ranges are small enough for them.
+
+//log base 2 in double: f = 2^e * m with m in [sqrt(0.5), sqrt(2)), s = (m - 1)/(m + 1) in [-0.172, 0.172) and
+//log_2(m) = 2/ln(2) * atanh(s) = 2/ln(2) * (s + s^3/3 + ... + s^13/13)
+static INLINE double D_log2(float f)
+{
+    unsigned int x = ASINT(&f);
+    double m, s, s2;
+    int e;
+
+    //Zero, denormals and negative numbers
+    if(x < MinNormAsInt || x >= 0x80000000)
+        return -126.0;
+
+    e = (int) (x >> 23) - 127;
+    x = (x & 0x007FFFFF) | OneAsInt;
+    if(x >= SqrtTwoAsInt){
+        x -= 0x00800000;
+        e++;
+    }
+    m = ASFLOAT(&x);
+    s = (m - 1.0)/(m + 1.0);
+    s2 = s*s;
+
+    return (double) e + 2.8853900817779268*s*(1.0 + s2*(1.0/3 + s2*(1.0/5 + s2*(1.0/7 + s2*(1.0/9 + s2*(1.0/11 + s2*(1.0/13)))))));
+}
+
+//exp base 2 in double, rounded to float: y = i + x with integer i and x in [-0.5, 0.5] and 2^x = e^z = 1 + z + z^2/2! + ... + z^11/11! with z = x*ln(2)
+static INLINE float D_exp2(double y)
+{
+    double z, p;
+    float r;
+    unsigned int bits;
+    int i;
+
+    //Stay within normalized floats
+    if(y > 127.0) y = 127.0;
+    if(y < -125.0) y = -125.0;
+
+    i = (int) (y >= 0 ? y + 0.5 : y - 0.5);         //Round to nearest
+    z = (y - (double) i)*0.69314718055994531;
+
+    p = 1.0 + z*(1.0 + z*(1.0/2 + z*(1.0/6 + z*(1.0/24 + z*(1.0/120 + z*(1.0/720 + z*(1.0/5040
+      + z*(1.0/40320 + z*(1.0/362880 + z*(1.0/3628800 + z*(1.0/39916800)))))))))));
+
+    //The only rounding. Multiplying by 2^i afterwards is exact
+    r = (float) p;
+    bits = ASINT(&r) + ((unsigned int) i << 23);
+    return ASFLOAT(&bits);
+}
+
+// ########## Tiered functions. These are meant to be used by the acceleration code
+
+//log base 2: log_2(f)
+static INLINE void F_log2(float *f, int precision)
+{
+    if(precision == PRECISION_FAST)
+        B_log2(f);
+    else if(precision == PRECISION_BALANCED)
+        P_log2(f);
+    else
+        *f = (float) D_log2(*f);
+}
+
+//exp base 2: 2^f
+static INLINE void F_exp2(float *f, int precision)
+{
+    if(precision == PRECISION_FAST)
+        B_exp2(f);
+    else if(precision == PRECISION_BALANCED)
+        P_exp2(f);
+    else
+        *f = D_exp2(*f);
+}
+
+//power: f^p for f > 0
+static INLINE void F_pow(float *f, float *p, int precision)
+{
+    if(precision == PRECISION_FAST){
+        B_pow(f, p);
+        return;
+    }
+    if(precision == PRECISION_EXACT){
+        //The product stays in double, so the error of log_2(f) is not scaled up to float ulps
+        *f = D_exp2(D_log2(*f) * *p);
+        return;
+    }
+    P_log2(f);
+    *f *= *p;
+    P_exp2(f);
+}
+
+//sqrt: Blinn's approximation, refined by one (fast), two (balanced) or three (exact) Newton iterations.
+//The exact tier iterates in double, so only the final rounding to float remains
+static INLINE void F_sqrt(float *f, int precision)
+{
+    unsigned int x;
+    float y;
+    double d;
+    int i;
+
+    x = ((ASINT(f) >> 1) + (OneAsInt >> 1));
+    y = ASFLOAT(&x);
+    if(precision == PRECISION_EXACT){
+        d = y;
+        for(i = 0; i <= precision; i++)
+            d = (d*d + *f)/(2*d);
+        *f = (float) d;
+        return;
+    }
+    for(i = 0; i <= precision; i++)
+        y = (y*y + *f)/(2*y);
+    *f = y;
+}
+
 //Checks, if a float is a finite number or NaN/Infinity
 static const unsigned int NaNAsInt = 0xFFFFFFFF;   //NaN
 static const unsigned int PInfAsInt = 0x7F800000;  //Positive Infinity
@@ -0,0 +1,177 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "hidmouse.h"
+#include "report.h"
+#include "accel.h"
+#include "util.h"
+
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/module.h>
+#include <linux/input.h>
+#include <linux/hid.h>
+
+// HID backend of leetmouse
+// In contrast to usbmouse.c, this is a real HID driver: hid-core takes care of the transport (USB, Bluetooth, I2C or uhid), fetching the report descriptor and the URBs.
+// We only hook into the raw reports via .raw_event and feed them through the same report processing as the USB backend.
+//
+// The id table is empty on purpose: hid-generic yields every device to any other driver, whose id table matches it. A catch-all table would steal keyboards and everything else.
+// Devices are added via the new_id file of the driver instead (see 'leetmouse_manage bind_hid'), which binds all future instances of that device directly to us:
+//     echo "<bus> <vendor> <product>" > /sys/bus/hid/drivers/leetmouse_hid/new_id
+//
+// Not every interface of a mouse carries the pointer. Interfaces without X and Y axes (e.g. the keyboard interface of a gaming mouse) are left to hid-input as hid-generic would handle them.
+// On interfaces, that mix the pointer with other reports (e.g. consumer keys or a keyboard behind other report IDs), hid-input keeps serving all reports, which do not carry a pointer field.
+
+struct hid_mouse {
+    struct hid_device *hdev;
+    struct input_dev *input;    //NULL, if the interface carries no pointer and is left to hid-input entirely
+    struct report_positions pos;
+    struct report_state report;
+};
+
+static int hid_mouse_raw_event(struct hid_device *hdev, struct hid_report *report, u8 *data, int size)
+{
+    struct hid_mouse *mouse = hid_get_drvdata(hdev);
+
+    //Reports without pointer fields are hid-input's
+    if (!mouse->input || !mouse->pos.fields[report->id])
+        return 0;
+
+    report_events(&mouse->report, &mouse->pos, ktime_get(), data, size);
+
+    //Let hid-core pass the report on to hidraw. hid-input ignores it (see hid_mouse_input_mapping)
+    return 0;
+}
+
+//hid-input must not create its own pointer: Every usage of a report with pointer fields is ours, all others are mapped as usual
+static int hid_mouse_input_mapping(struct hid_device *hdev, struct hid_input *hi, struct hid_field *field, struct hid_usage *usage, unsigned long **bit, int *max)
+{
+    struct hid_mouse *mouse = hid_get_drvdata(hdev);
+
+    if (mouse->input && mouse->pos.fields[field->report->id])
+        return -1;
+    return 0;
+}
+
+static int hid_mouse_open(struct input_dev *dev)
+{
+    struct hid_mouse *mouse = input_get_drvdata(dev);
+
+    return hid_hw_open(mouse->hdev);
+}
+
+static void hid_mouse_close(struct input_dev *dev)
+{
+    struct hid_mouse *mouse = input_get_drvdata(dev);
+
+    hid_hw_close(mouse->hdev);
+    report_stop(&mouse->report);
+}
+
+static int hid_mouse_probe(struct hid_device *hdev, const struct hid_device_id *id)
+{
+    struct hid_mouse *mouse;
+    struct input_dev *input;
+    int ret;
+
+    mouse = devm_kzalloc(&hdev->dev, sizeof(*mouse), GFP_KERNEL);
+    if (!mouse)
+        return -ENOMEM;
+    mouse->hdev = hdev;
+
+    ret = hid_parse(hdev);
+    if (ret)
+        return ret;
+
+    hid_set_drvdata(hdev, mouse);
+
+    //Returning an error would leave the interface without any driver, since hid-generic yields to us
+    ret = parse_report_desc((unsigned char *) hdev->rdesc, hdev->rsize, &mouse->pos);
+    if (ret < 0 || mouse->pos.x.type == EXTRACT_NONE || mouse->pos.y.type == EXTRACT_NONE) {
+        hid_info(hdev, "no pointer axes found, leaving the interface to hid-input\n");
+        return hid_hw_start(hdev, HID_CONNECT_DEFAULT);
+    }
+
+    input = input_allocate_device();
+    if (!input)
+        return -ENOMEM;
+    mouse->input = input;
+    ret = report_init(&mouse->report, input, &hdev->dev);
+    if (ret)
+        goto fail_report;
+
+    input->name = hdev->name;
+    input->phys = hdev->phys;
+    input->uniq = hdev->uniq;
+    input->id.bustype = hdev->bus;
+    input->id.vendor = hdev->vendor;
+    input->id.product = hdev->product;
+    input->id.version = hdev->version;
+    input->dev.parent = &hdev->dev;
+
+    report_capabilities(input);
+
+    input_set_drvdata(input, mouse);
+    input->open = hid_mouse_open;
+    input->close = hid_mouse_close;
+
+    //The pointer is the input device above. hid-input only gets the other reports (see hid_mouse_input_mapping), hidraw stays available
+    ret = hid_hw_start(hdev, HID_CONNECT_DEFAULT);
+    if (ret)
+        goto fail_start;
+
+    ret = input_register_device(input);
+    if (ret)
+        goto fail_register;
+
+    return 0;
+
+fail_register:
+    hid_hw_stop(hdev);
+fail_start:
+    report_exit(&mouse->report);
+fail_report:
+    input_free_device(input);
+    return ret;
+}
+
+static void hid_mouse_remove(struct hid_device *hdev)
+{
+    struct hid_mouse *mouse = hid_get_drvdata(hdev);
+
+    if (!mouse->input) {
+        hid_hw_stop(hdev);
+        return;
+    }
+
+    //Unregister first, like in-tree drivers do: If the device is open, this closes it via hid_mouse_close(), while the transport still runs.
+    //hidraw may keep the transport open, so .raw_event can still run until hid_hw_stop(). The reference keeps the input device alive until then
+    input_get_device(mouse->input);
+    input_unregister_device(mouse->input);
+    hid_hw_stop(hdev);
+    report_exit(&mouse->report);
+    input_put_device(mouse->input);
+}
+
+static const struct hid_device_id hid_mouse_id_table[] = {
+    { }    /* Terminating entry. Devices are added via new_id (see above) */
+};
+
+static struct hid_driver hid_mouse_driver = {
+    .name        = "leetmouse_hid",
+    .id_table    = hid_mouse_id_table,
+    .probe       = hid_mouse_probe,
+    .remove      = hid_mouse_remove,
+    .raw_event   = hid_mouse_raw_event,
+    .input_mapping = hid_mouse_input_mapping,
+};
+
+int hid_mouse_register(void)
+{
+    return hid_register_driver(&hid_mouse_driver);
+}
+
+void hid_mouse_unregister(void)
+{
+    hid_unregister_driver(&hid_mouse_driver);
+}
@@ -0,0 +1,10 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef _HIDMOUSE_H
+#define _HIDMOUSE_H
+
+// HID backend of leetmouse (see hidmouse.c)
+int hid_mouse_register(void);
+void hid_mouse_unregister(void);
+
+#endif  //_HIDMOUSE_H
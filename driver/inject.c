@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "inject.h"
+#include "report.h"
+#include "util.h"
+#include "leetmouse_uapi.h"
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/fs.h>
+#include <linux/miscdevice.h>
+#include <linux/mutex.h>
+#include <linux/uaccess.h>
+#include <linux/input.h>
+
+// Injection backend of leetmouse: /dev/leetmouse-inject (see leetmouse_uapi.h for the protocol)
+// Each open file is a virtual mouse. Instead of an URB, a write() delivers the report, which then takes the same way as the reports of the other backends:
+// report_events() with its extraction, acceleration, statistics, tracepoints and capture ring. The result comes out of a real evdev node.
+
+struct inject_mouse {
+    struct mutex lock;                          // Serializes the writes, like the completions of an endpoint
+    struct input_dev *input;                    // NULL until the descriptor has been written
+    struct report_positions pos;
+    struct report_state report;
+    unsigned char buf[LEETMOUSE_INJECT_MAX];
+};
+
+static int inject_create(struct inject_mouse *mouse, int len)
+{
+    struct input_dev *input;
+    int ret;
+
+    ret = parse_report_desc(mouse->buf, len, &mouse->pos);
+    if (ret < 0)
+        return ret;
+    if (mouse->pos.x.type == EXTRACT_NONE || mouse->pos.y.type == EXTRACT_NONE)
+        return -EINVAL;
+
+    input = input_allocate_device();
+    if (!input)
+        return -ENOMEM;
+    input->name = LEETMOUSE_INJECT_NAME;
+    input->phys = "leetmouse/inject";
+    input->id.bustype = BUS_VIRTUAL;
+    report_capabilities(input);
+
+    ret = input_register_device(input);
+    if (ret) {
+        input_free_device(input);
+        return ret;
+    }
+
+    //There is no other device behind it, so the input device itself names it in debugfs
+    ret = report_init(&mouse->report, input, &input->dev);
+    if (ret) {
+        input_unregister_device(input);
+        return ret;
+    }
+    mouse->input = input;
+    return 0;
+}
+
+static ssize_t inject_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+{
+    struct inject_mouse *mouse = file->private_data;
+    struct leetmouse_inject *hdr = (struct leetmouse_inject *) mouse->buf;
+    ktime_t now = ktime_get();
+    ssize_t ret = count;
+
+    if (count > LEETMOUSE_INJECT_MAX)
+        return -EMSGSIZE;
+
+    mutex_lock(&mouse->lock);
+    if (copy_from_user(mouse->buf, buf, count)) {
+        ret = -EFAULT;
+        goto exit;
+    }
+
+    if (!mouse->input) {
+        int err = inject_create(mouse, count);
+
+        if (err)
+            ret = err;
+    } else if (count <= sizeof(*hdr)) {
+        ret = -EINVAL;
+    } else {
+        report_events(&mouse->report, &mouse->pos, hdr->time ? (ktime_t) hdr->time : now,
+            mouse->buf + sizeof(*hdr), count - sizeof(*hdr));
+    }
+exit:
+    mutex_unlock(&mouse->lock);
+    return ret;
+}
+
+static int inject_open(struct inode *inode, struct file *file)
+{
+    struct inject_mouse *mouse;
+
+    mouse = kzalloc(sizeof(*mouse), GFP_KERNEL);
+    if (!mouse)
+        return -ENOMEM;
+    mutex_init(&mouse->lock);
+
+    file->private_data = mouse;
+    return nonseekable_open(inode, file);
+}
+
+static int inject_release(struct inode *inode, struct file *file)
+{
+    struct inject_mouse *mouse = file->private_data;
+
+    if (mouse->input) {
+        //The capture device hangs below the input device, so it has to go first
+        report_exit(&mouse->report);
+        input_unregister_device(mouse->input);
+    }
+    kfree(mouse);
+    return 0;
+}
+
+static const struct file_operations inject_fops = {
+    .owner   = THIS_MODULE,
+    .open    = inject_open,
+    .release = inject_release,
+    .write   = inject_write,
+};
+
+static struct miscdevice inject_misc = {
+    .minor = MISC_DYNAMIC_MINOR,
+    .name  = "leetmouse-inject",
+    .fops  = &inject_fops,
+    .mode  = 0600,
+};
+
+int inject_register(void)
+{
+    return misc_register(&inject_misc);
+}
+
+void inject_unregister(void)
+{
+    misc_deregister(&inject_misc);
+}
@@ -0,0 +1,10 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef _INJECT_H
+#define _INJECT_H
+
+// Virtual mice fed from userspace, for testing without hardware (see inject.c)
+int inject_register(void);
+void inject_unregister(void);
+
+#endif  //_INJECT_H
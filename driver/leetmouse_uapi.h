@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: GPL-2.0-or-later WITH Linux-syscall-note
+
+#ifndef _LEETMOUSE_UAPI_H
+#define _LEETMOUSE_UAPI_H
+
+#include <linux/types.h>
+
+// Interfaces of leetmouse towards userspace tools. Include this header in them as it is.
+
+// ########## Capture ring: /dev/leetmouse-capN
+// Every mouse gets a capture device (its sysfs node /sys/class/misc/leetmouse-capN/device points to the mouse).
+// Only one reader at a time. While it is open, every report ends up in a ring buffer, which the reader mmap()s:
+//
+//     int fd = open("/dev/leetmouse-cap0", O_RDWR);                // The reader writes 'tail' through the shared mapping
+//     struct leetmouse_capture_header *h = mmap(NULL, LEETMOUSE_CAPTURE_MMAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+//     struct leetmouse_capture_record *r = (void *) h + h->data_offset;
+//     for(;;){
+//         __u64 head = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+//         for(; tail != head; tail++)
+//             consume(&r[tail & (h->records - 1)]);
+//         __atomic_store_n(&h->tail, tail, __ATOMIC_RELEASE);
+//         poll(&(struct pollfd){ fd, POLLIN }, 1, -1);         // Only needed, once the ring ran empty
+//     }
+//
+// The driver only writes 'head' and 'dropped', the reader only 'tail'. Reports arriving while the ring is full are dropped, never overwritten.
+// debug/capture is a complete reader.
+
+#define LEETMOUSE_CAPTURE_VERSION 1
+#define LEETMOUSE_CAPTURE_RECORDS 4096          // Power of 2. About 0.5s at 8 kHz
+#define LEETMOUSE_CAPTURE_DATA 32               // Bytes of a raw report kept
+
+struct leetmouse_capture_header {
+    __u32 version;
+    __u32 record_size;                          // sizeof(struct leetmouse_capture_record)
+    __u32 records;
+    __u32 data_offset;                          // Offset of the first record in the mapping
+    __u64 head __attribute__((aligned(64)));    // Records written so far
+    __u64 dropped;                              // Records lost, because the ring was full
+    __u64 tail __attribute__((aligned(64)));    // Records consumed so far
+};
+
+struct leetmouse_capture_record {
+    __u64 time;                                 // ns, CLOCK_MONOTONIC
+    __u16 len;                                  // Length of the raw report
+    __u8 fields;                                // Fields carried by the report (enum report_field in util.h). Reports without any are not captured.
+                                                // 0 for the motion, the flush timer emitted after deferred reports: All but time and out_* are 0 then
+    __u8 deferred;                              // The motion could not be accelerated right away (out_* are 0)
+    __s32 btn;                                  // Extracted from the report. 0 for fields it does not carry
+    __s32 x, y, wheel;
+    __s32 out_x, out_y, out_wheel;              // Reported to the input device
+    __u8 data[LEETMOUSE_CAPTURE_DATA];          // Raw report, cut to LEETMOUSE_CAPTURE_DATA bytes
+};
+
+#define LEETMOUSE_CAPTURE_DATA_OFFSET 4096
+#define LEETMOUSE_CAPTURE_MMAP_SIZE (LEETMOUSE_CAPTURE_DATA_OFFSET + LEETMOUSE_CAPTURE_RECORDS * sizeof(struct leetmouse_capture_record))
+
+// ########## Report injection: /dev/leetmouse-inject
+// Every open() creates a virtual mouse, which lives until close(). It shows up as an ordinary input device named LEETMOUSE_INJECT_NAME.
+// The first write() is the raw report descriptor (as in debug/devices/*_descriptor_raw.txt). It has to declare X and Y.
+// Every further write() is a single report: struct leetmouse_inject, directly followed by the raw report bytes.
+// The reports go through the same report processing as the ones of a real mouse (report_events() in report.c).
+// See 'replay -k' in debug/replay.
+
+#define LEETMOUSE_INJECT_NAME "Leetmouse virtual mouse"
+#define LEETMOUSE_INJECT_MAX 4096                   // Longest write(), descriptor as well as report
+
+struct leetmouse_inject {
+    __u64 time;                                     // ns, CLOCK_MONOTONIC. 0 uses the time of the write()
+};
+
+#endif  //_LEETMOUSE_UAPI_H
@@ -0,0 +1,199 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "report.h"
+#include "config.h"
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/err.h>
+#include <linux/string.h>
+#include <linux/version.h>
+
+#define CREATE_TRACE_POINTS
+#include "trace.h"
+
+void report_capabilities(struct input_dev *dev)
+{
+    dev->evbit[0] = BIT_MASK(EV_KEY) | BIT_MASK(EV_REL);
+    dev->keybit[BIT_WORD(BTN_MOUSE)] = BIT_MASK(BTN_LEFT) |
+        BIT_MASK(BTN_RIGHT) | BIT_MASK(BTN_MIDDLE);
+    dev->relbit[0] = BIT_MASK(REL_X) | BIT_MASK(REL_Y);
+    dev->keybit[BIT_WORD(BTN_MOUSE)] |= BIT_MASK(BTN_SIDE) |
+        BIT_MASK(BTN_EXTRA);
+    dev->relbit[0] |= BIT_MASK(REL_WHEEL);
+}
+
+static int report_accel(struct report_state *rs, ktime_t now, int *x, int *y, int *wheel)
+{
+    struct accel_state *a = &rs->accel;
+    int ret = accelerate(a, now, x, y, wheel);
+
+    trace_leetmouse_accel(rs->input, ret, a->last_ns, a->last_speed, a->last_mult, a->last_carry_x, a->last_carry_y);
+    return ret;
+}
+
+static void report_rel(struct report_state *rs, int x, int y, int wheel, bool flushed)
+{
+    input_report_rel(rs->input, REL_X,     x);
+    input_report_rel(rs->input, REL_Y,     y);
+    input_report_rel(rs->input, REL_WHEEL, wheel);
+    trace_leetmouse_emit(rs->input, x, y, wheel, flushed);
+}
+
+//Accelerates and reports the motion. Unless it returns 0, the motion has not been reported
+static int report_motion(struct report_state *rs, ktime_t now, int *x, int *y, int *wheel)
+{
+    int ret = report_accel(rs, now, x, y, wheel);
+
+    if(!ret){
+        report_rel(rs, *x, *y, *wheel, false);
+    } else if(ret != -ENODEV){
+        //The motion stays buffered in the accel state. Flush it, if no other report picks it up before
+        stats_inc(&rs->stats, ret == -EFAULT ? STATS_FLOAT_TRAP : STATS_DEFERRED);
+        if(!hrtimer_is_queued(&rs->flush))
+            hrtimer_start(&rs->flush, ns_to_ktime(FLUSH_DELAY * NSEC_PER_USEC), HRTIMER_MODE_REL);
+    }
+    return ret;
+}
+
+//Emits the buffered motion with the multiplier of the last report. accel_flush() needs no FPU and leaves the frametime alone,
+//so the next report still measures its speed against the previous one
+static enum hrtimer_restart report_flush(struct hrtimer *timer)
+{
+    struct report_state *rs = container_of(timer, struct report_state, flush);
+    struct capture_ring *ring;
+    struct leetmouse_capture_record *rec;
+    unsigned long flags;
+    int x, y, wheel;
+
+    spin_lock_irqsave(&rs->lock, flags);
+    //A report in between might already have taken the buffered motion along
+    if(rs->accel.buffer_x || rs->accel.buffer_y || rs->accel.buffer_whl){
+        if(!accel_flush(&rs->accel, &x, &y, &wheel)){
+            report_rel(rs, x, y, wheel, true);
+            input_sync(rs->input);
+            stats_inc(&rs->stats, STATS_FLUSHED);
+
+            //Flush record: No report behind it, only the emitted motion
+            ring = capture_ring(rs->capture);
+            rec = capture_reserve(ring);
+            if(rec){
+                memset(rec, 0, sizeof(*rec));
+                rec->time      = ktime_to_ns(ktime_get());
+                rec->out_x     = x;
+                rec->out_y     = y;
+                rec->out_wheel = wheel;
+                capture_commit(rs->capture, ring);
+            }
+        }
+    }
+    spin_unlock_irqrestore(&rs->lock, flags);
+
+    return HRTIMER_NORESTART;
+}
+
+int report_init(struct report_state *rs, struct input_dev *input, struct device *parent)
+{
+    int ret;
+
+    accel_init_state(&rs->accel);
+    rs->input = input;
+    spin_lock_init(&rs->lock);
+    //hrtimer_init() has been replaced by hrtimer_setup(), which takes the callback along
+    #if LINUX_VERSION_CODE < KERNEL_VERSION(6,13,0)
+        hrtimer_init(&rs->flush, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+        rs->flush.function = report_flush;
+    #else
+        hrtimer_setup(&rs->flush, report_flush, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    #endif
+
+    ret = stats_create(&rs->stats, dev_name(parent));
+    if(ret)
+        return ret;
+    ret = debuglog_create(&rs->log, rs->stats.dir);
+    if(ret)
+        goto fail_log;
+    rs->capture = capture_create(parent);
+    if(IS_ERR(rs->capture)){
+        ret = PTR_ERR(rs->capture);
+        goto fail_capture;
+    }
+    return 0;
+
+fail_capture:
+    debuglog_destroy(&rs->log);
+fail_log:
+    stats_destroy(&rs->stats);
+    return ret;
+}
+
+void report_exit(struct report_state *rs)
+{
+    report_stop(rs);
+    capture_destroy(rs->capture);
+    //Removes the debugfs files of the log as well
+    stats_destroy(&rs->stats);
+    debuglog_destroy(&rs->log);
+}
+
+void report_stop(struct report_state *rs)
+{
+    hrtimer_cancel(&rs->flush);
+}
+
+int report_events(struct report_state *rs, struct report_positions *pos, ktime_t now, unsigned char *data, int len)
+{
+    struct input_dev *dev = rs->input;
+    struct capture_ring *ring;
+    struct leetmouse_capture_record *rec;
+    int btn, x, y, wheel, fields, ret = 0;
+    unsigned long flags;
+
+    stats_report(&rs->stats, now);
+    if(static_branch_unlikely(&leetmouse_debug))
+        debuglog_write(&rs->log, now, data, len);
+
+    //Only touch what this report carries. Reports without buttons or motion are dropped before any accel work
+    fields = extract_mouse_events(data, len, pos, &btn, &x, &y, &wheel);
+    if(!fields)
+        return 0;
+    trace_leetmouse_extract(dev, fields, btn, x, y, wheel);
+
+    spin_lock_irqsave(&rs->lock, flags);
+
+    //Capture ring: Only reserves a record, while somebody reads. The lock keeps the ring alive (RCU)
+    ring = capture_ring(rs->capture);
+    rec = capture_reserve(ring);
+    if(rec){
+        rec->time = ktime_to_ns(now);
+        rec->len = len;
+        memcpy(rec->data, data, min_t(int, len, LEETMOUSE_CAPTURE_DATA));
+        rec->fields = fields;
+        rec->btn   = btn;
+        rec->x     = x;
+        rec->y     = y;
+        rec->wheel = wheel;
+    }
+
+    if(fields & FIELD_BUTTON){
+        input_report_key(dev, BTN_LEFT,   btn & 0x01);
+        input_report_key(dev, BTN_RIGHT,  btn & 0x02);
+        input_report_key(dev, BTN_MIDDLE, btn & 0x04);
+        input_report_key(dev, BTN_SIDE,   btn & 0x08);
+        input_report_key(dev, BTN_EXTRA,  btn & 0x10);
+    }
+    if(fields & (FIELD_X | FIELD_Y | FIELD_WHEEL))
+        ret = report_motion(rs, now, &x, &y, &wheel);
+    input_sync(dev);
+
+    if(rec){
+        rec->deferred  = ret != 0;
+        rec->out_x     = ret ? 0 : x;
+        rec->out_y     = ret ? 0 : y;
+        rec->out_wheel = ret ? 0 : wheel;
+        capture_commit(rs->capture, ring);
+    }
+    spin_unlock_irqrestore(&rs->lock, flags);
+
+    stats_record(&rs->stats, STATS_PROCESS, ktime_to_ns(ktime_sub(ktime_get(), now)));
+    return fields;
+}
@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef _REPORT_H
+#define _REPORT_H
+
+#include "accel.h"
+#include "stats.h"
+#include "debuglog.h"
+#include "capture.h"
+#include "util.h"
+#include <linux/input.h>
+#include <linux/hrtimer.h>
+#include <linux/spinlock.h>
+
+// Report processing shared by all backends (usbmouse.c, hidmouse.c)
+
+// Report processing state of a single device
+// When accelerate() cannot process the motion (FPU not usable in this IRQ), it keeps the motion buffered. Instead of waiting for the next report, which never comes once the mouse stops,
+// the flush timer emits the buffered motion with the multiplier of the last report after FLUSH_DELAY us (see accel_flush()).
+struct report_state {
+    struct accel_state accel;
+    struct input_dev *input;
+    spinlock_t lock;                    // Serializes the reports against the flush timer
+    struct hrtimer flush;
+    struct stats stats;
+    struct debuglog log;                // Raw reports, while the module parameter 'debug' is on
+    struct capture *capture;            // Raw and accelerated reports for userspace tools
+};
+
+// Declares the buttons and axes leetmouse reports on an input device
+void report_capabilities(struct input_dev *dev);
+
+// Sets up the state for reporting to 'input'. Must be called once before the first report_events()
+// 'parent' is the device the reports come from. Its name identifies the device in debugfs (see stats.c)
+int report_init(struct report_state *rs, struct input_dev *input, struct device *parent);
+
+// Releases what report_init() set up. The device must not report anymore
+void report_exit(struct report_state *rs);
+
+// Cancels a pending flush. Call it, once no more reports arrive (close, disconnect)
+void report_stop(struct report_state *rs);
+
+// Turns a raw HID report into input events: Extracts the fields carried by the report, accelerates the motion and syncs
+// Returns the fields found in the report (enum report_field). If 0, nothing has been reported
+int report_events(struct report_state *rs, struct report_positions *pos, ktime_t now, unsigned char *data, int len);
+
+#endif  //_REPORT_H
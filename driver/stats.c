@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "stats.h"
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/fs.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/math64.h>
+
+// Layout of /sys/kernel/debug/leetmouse/<device>/
+//     histograms   All histograms with their percentiles, followed by the non-empty buckets: from (ns), to (ns), count
+//     counters     All counters
+//     reset        Write anything to reset the histograms and counters. Reports arriving meanwhile may survive the reset
+//     log          Raw reports, see debuglog.h
+
+static struct dentry *stats_root;
+
+static const char *const stats_hist_names[STATS_HISTS] = { "interval", "process", "resubmit" };
+static const char *const stats_counter_names[STATS_COUNTERS] = { "deferred", "float_trap", "flushed", "overflow", "resubmit_err" };
+
+// Percentiles in per mille
+static const unsigned int stats_percentiles[] = { 500, 900, 990, 999 };
+
+// Smallest value of a bucket. The largest one is the smallest of the next bucket minus 1
+static u64 stats_bucket_lo(unsigned int b)
+{
+    unsigned int g = b >> STATS_SUB_BITS;
+
+    if (!g)
+        return b;
+    return (u64) (STATS_SUB + (b & (STATS_SUB - 1))) << (g - 1);
+}
+
+u64 stats_count(struct stats *s, enum stats_counter c)
+{
+    u64 sum = 0;
+    int cpu;
+
+    for_each_possible_cpu(cpu)
+        sum += READ_ONCE(per_cpu_ptr(s->cpu, cpu)->count[c]);
+    return sum;
+}
+
+static void stats_show_hist(struct seq_file *m, struct stats *s, enum stats_hist h, u64 *sum)
+{
+    u64 total = 0, cum = 0;
+    unsigned int b, p = 0;
+    int cpu;
+
+    memset(sum, 0, STATS_BUCKETS * sizeof(*sum));
+    for_each_possible_cpu(cpu) {
+        struct stats_cpu *c = per_cpu_ptr(s->cpu, cpu);
+
+        for (b = 0; b < STATS_BUCKETS; b++)
+            sum[b] += READ_ONCE(c->hist[h][b]);
+    }
+    for (b = 0; b < STATS_BUCKETS; b++)
+        total += sum[b];
+
+    //Percentiles are reported as the upper end of the bucket they fall into
+    seq_printf(m, "%s: %llu samples", stats_hist_names[h], total);
+    for (b = 0; b < STATS_BUCKETS && total && p < ARRAY_SIZE(stats_percentiles); b++) {
+        cum += sum[b];
+        while (p < ARRAY_SIZE(stats_percentiles) && cum * 1000 >= total * stats_percentiles[p]) {
+            seq_printf(m, ", p%u.%u <%llu", stats_percentiles[p] / 10, stats_percentiles[p] % 10, stats_bucket_lo(b + 1));
+            p++;
+        }
+    }
+    seq_putc(m, '\n');
+
+    for (b = 0; b < STATS_BUCKETS; b++)
+        if (sum[b])
+            seq_printf(m, "%12llu %12llu %12llu\n", stats_bucket_lo(b), stats_bucket_lo(b + 1) - 1, sum[b]);
+}
+
+static int stats_histograms_show(struct seq_file *m, void *unused)
+{
+    struct stats *s = m->private;
+    u64 *sum;
+    int h;
+
+    sum = kmalloc_array(STATS_BUCKETS, sizeof(*sum), GFP_KERNEL);
+    if (!sum)
+        return -ENOMEM;
+
+    for (h = 0; h < STATS_HISTS; h++) {
+        if (h)
+            seq_putc(m, '\n');
+        stats_show_hist(m, s, h, sum);
+    }
+
+    kfree(sum);
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(stats_histograms);
+
+static int stats_counters_show(struct seq_file *m, void *unused)
+{
+    struct stats *s = m->private;
+    int c;
+
+    for (c = 0; c < STATS_COUNTERS; c++)
+        seq_printf(m, "%-14s %llu\n", stats_counter_names[c], stats_count(s, c));
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(stats_counters);
+
+static ssize_t stats_reset_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+{
+    struct stats *s = file->private_data;
+    int cpu;
+
+    for_each_possible_cpu(cpu)
+        memset(per_cpu_ptr(s->cpu, cpu), 0, sizeof(struct stats_cpu));
+    return count;
+}
+
+static const struct file_operations stats_reset_fops = {
+    .owner  = THIS_MODULE,
+    .open   = simple_open,
+    .write  = stats_reset_write,
+    .llseek = noop_llseek,
+};
+
+void stats_init(void)
+{
+    //Like everywhere in the kernel, debugfs failures are not fatal. The files are just missing then
+    stats_root = debugfs_create_dir("leetmouse", NULL);
+}
+
+void stats_exit(void)
+{
+    debugfs_remove_recursive(stats_root);
+    stats_root = NULL;
+}
+
+int stats_create(struct stats *s, const char *name)
+{
+    s->cpu = alloc_percpu(struct stats_cpu);
+    if (!s->cpu)
+        return -ENOMEM;
+    s->last = 0;
+
+    s->dir = debugfs_create_dir(name, stats_root);
+    debugfs_create_file("histograms", 0444, s->dir, s, &stats_histograms_fops);
+    debugfs_create_file("counters", 0444, s->dir, s, &stats_counters_fops);
+    debugfs_create_file("reset", 0200, s->dir, s, &stats_reset_fops);
+    return 0;
+}
+
+void stats_destroy(struct stats *s)
+{
+    //Waits for readers still inside the files
+    debugfs_remove_recursive(s->dir);
+    s->dir = NULL;
+    free_percpu(s->cpu);
+    s->cpu = NULL;
+}
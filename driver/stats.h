@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef _STATS_H
+#define _STATS_H
+
+#include "util.h"
+#include <linux/types.h>
+#include <linux/ktime.h>
+#include <linux/percpu.h>
+#include <linux/bitops.h>
+
+// Per device statistics, exposed under debugfs: /sys/kernel/debug/leetmouse/<device>/
+// Every CPU records into its own copy, so the IRQ path gets away with a plain this_cpu_inc(). The copies are only summed up when read.
+// Histograms are log-linear: Each power of two is split into STATS_SUB linear buckets, so the resolution stays at 1/STATS_SUB of the value over the whole range.
+
+#define STATS_SUB_BITS 3
+#define STATS_SUB (1 << STATS_SUB_BITS)
+#define STATS_BUCKETS (32 << STATS_SUB_BITS)      // Up to 2^34 ns (~17 s). Anything larger ends up in the last bucket
+
+enum stats_hist {
+    STATS_INTERVAL,                     // Time between two reports (ns)
+    STATS_PROCESS,                      // Extraction and acceleration of a report (ns)
+    STATS_RESUBMIT,                     // Time spent in usb_submit_urb() to queue an URB again (ns)
+    STATS_HISTS
+};
+
+enum stats_counter {
+    STATS_DEFERRED,                     // Motion deferred, because the FPU was not usable (-EBUSY)
+    STATS_FLOAT_TRAP,                   // Motion deferred by the float trap (-EFAULT)
+    STATS_FLUSHED,                      // Deferred motion emitted by the flush timer
+    STATS_OVERFLOW,                     // Reports larger than the URB buffer (-EOVERFLOW)
+    STATS_RESUBMIT_ERR,                 // URBs that could not be resubmitted
+    STATS_COUNTERS
+};
+
+struct stats_cpu {
+    u64 hist[STATS_HISTS][STATS_BUCKETS];
+    u64 count[STATS_COUNTERS];
+};
+
+struct stats {
+    struct stats_cpu __percpu *cpu;
+    struct dentry *dir;
+    ktime_t last;                       // Timestamp of the last report
+};
+
+// Module wide debugfs directory
+void stats_init(void);
+void stats_exit(void);
+
+// Allocates the statistics of a device and exposes them as debugfs directory 'name'
+int stats_create(struct stats *s, const char *name);
+void stats_destroy(struct stats *s);
+
+// Sum of a counter over all CPUs
+u64 stats_count(struct stats *s, enum stats_counter c);
+
+// Bucket of a value. The first STATS_SUB values get a bucket each, from there on every power of two gets STATS_SUB buckets
+static INLINE unsigned int stats_bucket(u64 v)
+{
+    unsigned int e, b;
+
+    if (v < STATS_SUB)
+        return v;
+    e = fls64(v) - 1;
+    b = ((e - STATS_SUB_BITS + 1) << STATS_SUB_BITS) | ((v >> (e - STATS_SUB_BITS)) & (STATS_SUB - 1));
+    return b < STATS_BUCKETS ? b : STATS_BUCKETS - 1;
+}
+
+static INLINE void stats_record(struct stats *s, enum stats_hist h, s64 ns)
+{
+    this_cpu_inc(s->cpu->hist[h][stats_bucket(ns > 0 ? ns : 0)]);
+}
+
+static INLINE void stats_inc(struct stats *s, enum stats_counter c)
+{
+    this_cpu_inc(s->cpu->count[c]);
+}
+
+// Records the time since the previous report. Pauses in the motion end up in the upper buckets
+static INLINE void stats_report(struct stats *s, ktime_t now)
+{
+    if (s->last)
+        stats_record(s, STATS_INTERVAL, ktime_to_ns(ktime_sub(now, s->last)));
+    s->last = now;
+}
+
+#endif  //_STATS_H
@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Tracepoints along the report processing, from the URB completion to the input events. E.g.
+//     trace-cmd record -e leetmouse -e xhci-hcd -e sched_switch
+//     perf trace -e 'leetmouse:*'
+//     bpftrace -e 'tracepoint:leetmouse:leetmouse_accel { @mult = lhist(args->mult >> 16, 0, 10, 1); }'
+// Disabled, each one is a static branch (NOP). Fixed point values are Q16.16
+// Devices are named after their input device (inputN)
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM leetmouse
+
+#if !defined(_LEETMOUSE_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _LEETMOUSE_TRACE_H
+
+#include <linux/tracepoint.h>
+#include <linux/input.h>
+#include <linux/version.h>
+
+#ifndef _LEETMOUSE_TRACE_HELPERS
+#define _LEETMOUSE_TRACE_HELPERS
+    #if LINUX_VERSION_CODE < KERNEL_VERSION(6,10,0)
+        #define leet_assign_str(dst, src) __assign_str(dst, src)
+    #else
+        #define leet_assign_str(dst, src) __assign_str(dst)
+    #endif
+#endif
+
+// An interrupt URB completed (USB backend)
+TRACE_EVENT(leetmouse_urb,
+    TP_PROTO(struct input_dev *input, int status, int len, int in_flight),
+    TP_ARGS(input, status, len, in_flight),
+    TP_STRUCT__entry(
+        __string(dev, dev_name(&input->dev))
+        __field(int, status)
+        __field(int, len)
+        __field(int, in_flight)
+    ),
+    TP_fast_assign(
+        leet_assign_str(dev, dev_name(&input->dev));
+        __entry->status = status;
+        __entry->len = len;
+        __entry->in_flight = in_flight;
+    ),
+    TP_printk("%s status=%d len=%d in_flight=%d", __get_str(dev), __entry->status, __entry->len, __entry->in_flight)
+);
+
+// Raw fields of a report. 'fields' tells, which of them the report actually carries (enum report_field)
+TRACE_EVENT(leetmouse_extract,
+    TP_PROTO(struct input_dev *input, int fields, int btn, int x, int y, int wheel),
+    TP_ARGS(input, fields, btn, x, y, wheel),
+    TP_STRUCT__entry(
+        __string(dev, dev_name(&input->dev))
+        __field(int, fields)
+        __field(int, btn)
+        __field(int, x)
+        __field(int, y)
+        __field(int, wheel)
+    ),
+    TP_fast_assign(
+        leet_assign_str(dev, dev_name(&input->dev));
+        __entry->fields = fields;
+        __entry->btn = btn;
+        __entry->x = x;
+        __entry->y = y;
+        __entry->wheel = wheel;
+    ),
+    TP_printk("%s fields=0x%x btn=0x%02x x=%d y=%d wheel=%d", __get_str(dev), __entry->fields, __entry->btn, __entry->x, __entry->y, __entry->wheel)
+);
+
+// Outcome of accelerate(). 'status' is its return value. Unless 0, the motion got deferred and the other values are stale
+TRACE_EVENT(leetmouse_accel,
+    TP_PROTO(struct input_dev *input, int status, s64 ns, s64 speed, s64 mult, s64 carry_x, s64 carry_y),
+    TP_ARGS(input, status, ns, speed, mult, carry_x, carry_y),
+    TP_STRUCT__entry(
+        __string(dev, dev_name(&input->dev))
+        __field(int, status)
+        __field(s64, ns)
+        __field(s64, speed)
+        __field(s64, mult)
+        __field(s64, carry_x)
+        __field(s64, carry_y)
+    ),
+    TP_fast_assign(
+        leet_assign_str(dev, dev_name(&input->dev));
+        __entry->status = status;
+        __entry->ns = ns;
+        __entry->speed = speed;
+        __entry->mult = mult;
+        __entry->carry_x = carry_x;
+        __entry->carry_y = carry_y;
+    ),
+    TP_printk("%s status=%d frametime=%lld speed=%lld mult=%lld carry_x=%lld carry_y=%lld", __get_str(dev), __entry->status,
+        __entry->ns, __entry->speed, __entry->mult, __entry->carry_x, __entry->carry_y)
+);
+
+// Relative motion handed to the input core. 'flushed' is set, if it has been deferred motion emitted by the flush timer
+TRACE_EVENT(leetmouse_emit,
+    TP_PROTO(struct input_dev *input, int x, int y, int wheel, bool flushed),
+    TP_ARGS(input, x, y, wheel, flushed),
+    TP_STRUCT__entry(
+        __string(dev, dev_name(&input->dev))
+        __field(int, x)
+        __field(int, y)
+        __field(int, wheel)
+        __field(bool, flushed)
+    ),
+    TP_fast_assign(
+        leet_assign_str(dev, dev_name(&input->dev));
+        __entry->x = x;
+        __entry->y = y;
+        __entry->wheel = wheel;
+        __entry->flushed = flushed;
+    ),
+    TP_printk("%s x=%d y=%d wheel=%d%s", __get_str(dev), __entry->x, __entry->y, __entry->wheel, __entry->flushed ? " flushed" : "")
+);
+
+#endif  //_LEETMOUSE_TRACE_H
+
+// Outside of the include guard on purpose: define_trace.h includes this header once more
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE trace
+#include <trace/define_trace.h>
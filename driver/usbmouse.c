@@ -16,6 +16,11 @@
 #include "accel.h"
 #include "config.h"
 #include "util.h"
+#include "report.h"
+#include "stats.h"
+#include "hidmouse.h"
+#include "inject.h"
+#include "trace.h"
                                                                 //Leetmouse Mod END
 
 #include <linux/kernel.h>
@@ -25,6 +30,9 @@
 #include <linux/usb/input.h>
 #include <linux/hid.h>
 #include <linux/version.h>
+#include <linux/mutex.h>                                        //Leetmouse Mod
+#include <linux/workqueue.h>                                    //Leetmouse Mod
+#include <linux/math64.h>                                       //Leetmouse Mod
 
 /* for apple IDs */
 /*                                                              //Leetmouse Mod BEGIN
@@ -44,29 +52,85 @@ MODULE_AUTHOR(DRIVER_AUTHOR);
 MODULE_DESCRIPTION(DRIVER_DESC);
 MODULE_LICENSE("GPL");
 
+                                                                //Leetmouse Mod BEGIN
+// Interrupt URBs in flight per mouse. While one completion is processed, the host controller can already poll into the next URB
+#define MAX_URBS 4
+static unsigned int g_urbs = URB_QUEUE;
+module_param_named(urbs, g_urbs, uint, 0644);
+MODULE_PARM_DESC(urbs, "Number of interrupt URBs in flight per mouse (1-4). Applies to mice bound afterwards");
+
+// Polling interval override in us. Can be overridden per mouse via its sysfs attribute 'interval'
+static unsigned int g_interval = POLL_INTERVAL;
+module_param_named(interval, g_interval, uint, 0644);
+MODULE_PARM_DESC(interval, "Polling interval in us (0: As requested by the mouse). Rounded down to what bInterval can express. Applies whenever a mouse is opened");
+                                                                //Leetmouse Mod END
+
 struct usb_mouse {
     char name[128];
     char phys[64];
     struct usb_device *usbdev;
     struct input_dev *dev;
-    struct urb *irq;
+    struct urb *irq[MAX_URBS];                                  //Leetmouse Mod
+    int num_urbs;                                               //Leetmouse Mod
+    atomic_t in_flight;                                         //Leetmouse Mod
+    unsigned long queue_dry;                                    //Leetmouse Mod
 
-    signed char *data;
-    dma_addr_t data_dma;
+    signed char *data[MAX_URBS];                                //Leetmouse Mod
+    dma_addr_t data_dma[MAX_URBS];                              //Leetmouse Mod
+    int buffer_size;                                            //Leetmouse Mod
+
+                                                                //Leetmouse Mod BEGIN
+    struct mutex lock;                                          // Protects the URBs against a reallocation while (un)submitting them
+    bool open;
+    bool grown;                                                 // The buffers have already been grown after an EOVERFLOW
+    struct work_struct grow_work;
+
+    unsigned int interval_us;                                   // Per mouse polling interval override, 0 uses the module parameter
+    struct usb_host_endpoint *ep;                               // The interrupt IN endpoint. Its bInterval is patched by the override
+    u8 default_binterval;                                       // bInterval as requested by the mouse
+    int ifnum;
+    ktime_t last_complete;                                      // Measurement of the achieved report rate
+    s64 period_ns;
+                                                                //Leetmouse Mod END
 
     struct report_positions *data_pos;
+    struct report_state report;                                 //Leetmouse Mod
 };
 
+                                                                //Leetmouse Mod BEGIN
+//Average time between two reports (EWMA over ~8 reports). Pauses in the motion do not count
+static void usb_mouse_track_rate(struct usb_mouse *mouse, ktime_t now)
+{
+    s64 ns = ktime_to_ns(ktime_sub(now, mouse->last_complete));
+
+    mouse->last_complete = now;
+    if (ns <= 0 || ns > 100*NSEC_PER_MSEC)
+        return;
+    if (!mouse->period_ns)
+        WRITE_ONCE(mouse->period_ns, ns);
+    else
+        WRITE_ONCE(mouse->period_ns, mouse->period_ns + ((ns - mouse->period_ns) >> 3));
+}
+                                                                //Leetmouse Mod END
+
 static void usb_mouse_irq(struct urb *urb)
 {
     struct usb_mouse *mouse = urb->context;
-    signed char *data = mouse->data;
-    struct input_dev *dev = mouse->dev;
-    signed int btn, x, y, wheel;                                 //Leetmouse Mod
+    signed char *data = urb->transfer_buffer;                   //Leetmouse Mod
+    ktime_t now = ktime_get(), submit;                          //Leetmouse Mod
+    int in_flight = atomic_dec_return(&mouse->in_flight);       //Leetmouse Mod
     int status;
 
+    trace_leetmouse_urb(mouse->dev, urb->status, urb->actual_length, in_flight);  //Leetmouse Mod
+
     switch (urb->status) {
     case 0:            /* success */
+                                                                //Leetmouse Mod BEGIN
+        //No other URB was queued, so the host controller had nothing to poll into until this one is resubmitted
+        if (!in_flight)
+            mouse->queue_dry++;
+        usb_mouse_track_rate(mouse, now);
+                                                                //Leetmouse Mod END
         break;
     case -ECONNRESET:    /* unlink */
     case -ENOENT:
@@ -74,7 +138,11 @@ static void usb_mouse_irq(struct urb *urb)
         return;
                                                                 //Leetmouse Mod BEGIN
     case -EOVERFLOW:
-        printk("LEETMOUSE: EOVERFLOW. Try to increase BUFFER_SIZE from %d to %d in 'config.h'", BUFFER_SIZE, 2*BUFFER_SIZE);
+        //The report did not fit into the buffer. Grow the buffers once and resubmit all URBs from there
+        dev_warn_ratelimited(&mouse->usbdev->dev, "leetmouse: EOVERFLOW with a report buffer of %d bytes\n", mouse->buffer_size);
+        stats_inc(&mouse->report.stats, STATS_OVERFLOW);
+        if (!READ_ONCE(mouse->grown) && schedule_work(&mouse->grow_work))
+            return;
         goto resubmit;
                                                                 //Leetmouse Mod END
     /* -EPIPE:  should clear the halt */
@@ -83,48 +151,302 @@ static void usb_mouse_irq(struct urb *urb)
     }
 
                                                                 //Leetmouse Mod BEGIN
-    if(!extract_mouse_events(data, BUFFER_SIZE, mouse->data_pos, &btn, &x, &y, &wheel)){
-        input_report_key(dev, BTN_LEFT,   btn & 0x01);
-        input_report_key(dev, BTN_RIGHT,  btn & 0x02);
-        input_report_key(dev, BTN_MIDDLE, btn & 0x04);
-        input_report_key(dev, BTN_SIDE,   btn & 0x08);
-        input_report_key(dev, BTN_EXTRA,  btn & 0x10);
-        if(!accelerate(&x,&y,&wheel)){
-            input_report_rel(dev, REL_X,     x);
-            input_report_rel(dev, REL_Y,     y);
-            input_report_rel(dev, REL_WHEEL, wheel);
-        }
-    }
+    //Reports without buttons or motion are dropped before any accel work
+    report_events(&mouse->report, mouse->data_pos, now, data, urb->actual_length);
                                                                 //Leetmouse Mod END
 
-    input_sync(dev);
 resubmit:
+    atomic_inc(&mouse->in_flight);                              //Leetmouse Mod
+    submit = ktime_get();                                       //Leetmouse Mod
     status = usb_submit_urb (urb, GFP_ATOMIC);
-    if (status)
+    if (status) {                                               //Leetmouse Mod
+        atomic_dec(&mouse->in_flight);                          //Leetmouse Mod
+        stats_inc(&mouse->report.stats, STATS_RESUBMIT_ERR);    //Leetmouse Mod
         dev_err(&mouse->usbdev->dev,
             "can't resubmit intr, %s-%s/input0, status %d\n",
             mouse->usbdev->bus->bus_name,
             mouse->usbdev->devpath, status);
+    } else                                                      //Leetmouse Mod
+        stats_record(&mouse->report.stats, STATS_RESUBMIT, ktime_to_ns(ktime_sub(ktime_get(), submit)));   //Leetmouse Mod
+}
+
+                                                                //Leetmouse Mod BEGIN
+static bool usb_mouse_high_speed(struct usb_device *dev)
+{
+    return dev->speed == USB_SPEED_HIGH || dev->speed >= USB_SPEED_SUPER;
+}
+
+//Polling interval as bInterval of the endpoint: Frames for low and full speed, 2^(bInterval - 1) microframes for high speed and faster
+//Overrides are clamped to what the bus speed allows and rounded down to what bInterval can express
+static u8 usb_mouse_binterval(struct usb_mouse *mouse)
+{
+    struct usb_device *dev = mouse->usbdev;
+    unsigned int us = mouse->interval_us ? mouse->interval_us : READ_ONCE(g_interval);
+
+    if (!us)
+        return mouse->default_binterval;
+    if (usb_mouse_high_speed(dev))
+        return fls(clamp_t(unsigned int, us / 125, 1, 1 << 15));
+    return clamp_t(unsigned int, us / 1000, 1, 255);
+}
+
+//Polling period of the endpoint in us, as the host controller schedules it
+static unsigned int usb_mouse_period_us(struct usb_mouse *mouse)
+{
+    u8 b = READ_ONCE(mouse->ep->desc.bInterval);
+
+    if (usb_mouse_high_speed(mouse->usbdev))
+        return 125u << (clamp_t(u8, b, 1, 16) - 1);
+    return 1000u * max_t(u8, b, 1);
+}
+
+//Host controllers do not take the period from urb->interval: xHCI builds its endpoint context from bInterval, EHCI keeps the period of its QH
+//from the first submit. So an override patches bInterval and re-adds the endpoint by reinstalling the altsetting. No URB may be in flight
+static void usb_mouse_set_binterval(struct usb_mouse *mouse, u8 binterval)
+{
+    struct usb_interface *intf = usb_ifnum_to_if(mouse->usbdev, mouse->ifnum);
+    int ret;
+
+    //A mouse that has been unplugged takes its descriptors along
+    if (mouse->ep->desc.bInterval == binterval || !intf || mouse->usbdev->state == USB_STATE_NOTATTACHED)
+        return;
+    WRITE_ONCE(mouse->ep->desc.bInterval, binterval);
+    ret = usb_set_interface(mouse->usbdev, mouse->ifnum, intf->cur_altsetting->desc.bAlternateSetting);
+    if (ret)
+        dev_warn(&mouse->usbdev->dev, "leetmouse: Cannot re-add the endpoint (error %d), the polling interval may not change\n", ret);
+}
+
+//All URBs are queued at once. Each one requeues itself after its completion, so they take turns round-robin
+static int usb_mouse_submit_urbs(struct usb_mouse *mouse)
+{
+    int n, interval;
+
+    usb_mouse_set_binterval(mouse, usb_mouse_binterval(mouse));
+    //urb->interval in (micro)frames, like usb_fill_int_urb() derives it from bInterval
+    interval = mouse->ep->desc.bInterval;
+    if (usb_mouse_high_speed(mouse->usbdev))
+        interval = 1 << (interval - 1);
+
+    mouse->last_complete = 0;
+    mouse->period_ns = 0;
+    for (n = 0; n < mouse->num_urbs; n++) {
+        mouse->irq[n]->dev = mouse->usbdev;
+        mouse->irq[n]->interval = interval;
+        atomic_inc(&mouse->in_flight);
+        if (usb_submit_urb(mouse->irq[n], GFP_KERNEL)) {
+            atomic_dec(&mouse->in_flight);
+            while (n--)
+                usb_kill_urb(mouse->irq[n]);
+            return -EIO;
+        }
+    }
+    return 0;
+}
+
+static void usb_mouse_kill_urbs(struct usb_mouse *mouse)
+{
+    int n;
+
+    for (n = 0; n < mouse->num_urbs; n++)
+        usb_kill_urb(mouse->irq[n]);
 }
+                                                                //Leetmouse Mod END
 
 static int usb_mouse_open(struct input_dev *dev)
 {
     struct usb_mouse *mouse = input_get_drvdata(dev);
+    int ret;                                                    //Leetmouse Mod
 
-    mouse->irq->dev = mouse->usbdev;
-    if (usb_submit_urb(mouse->irq, GFP_KERNEL))
-        return -EIO;
+                                                                //Leetmouse Mod BEGIN
+    mutex_lock(&mouse->lock);
+    ret = usb_mouse_submit_urbs(mouse);
+    mouse->open = !ret;
+    mutex_unlock(&mouse->lock);
+                                                                //Leetmouse Mod END
 
-    return 0;
+    return ret;                                                 //Leetmouse Mod
 }
 
 static void usb_mouse_close(struct input_dev *dev)
 {
     struct usb_mouse *mouse = input_get_drvdata(dev);
 
-    usb_kill_urb(mouse->irq);
+                                                                //Leetmouse Mod BEGIN
+    mutex_lock(&mouse->lock);
+    mouse->open = false;
+    usb_mouse_kill_urbs(mouse);
+    mutex_unlock(&mouse->lock);
+    report_stop(&mouse->report);                                // No more reports, so nothing to flush either
+                                                                //Leetmouse Mod END
 }
 
+                                                                //Leetmouse Mod BEGIN
+static void usb_mouse_free_buffers(struct usb_device *dev, int size, signed char **data, dma_addr_t *dma)
+{
+    int n;
+
+    for (n = 0; n < MAX_URBS; n++) {
+        usb_free_coherent(dev, size, data[n], dma[n]);
+        data[n] = NULL;
+    }
+}
+
+//Allocates count buffers of size bytes. data must hold MAX_URBS NULL pointers. On failure, the caller frees the ones allocated so far
+static int usb_mouse_alloc_buffers(struct usb_device *dev, int size, int count, signed char **data, dma_addr_t *dma)
+{
+    int n;
+
+    for (n = 0; n < count; n++) {
+        data[n] = usb_alloc_coherent(dev, size, GFP_KERNEL, &dma[n]);
+        if (!data[n])
+            return -ENOMEM;
+    }
+    return 0;
+}
+
+static void usb_mouse_free_urbs(struct usb_device *dev, struct usb_mouse *mouse)
+{
+    int n;
+
+    for (n = 0; n < MAX_URBS; n++)
+        usb_free_urb(mouse->irq[n]);
+    usb_mouse_free_buffers(dev, mouse->buffer_size, mouse->data, mouse->data_dma);
+}
+
+//Points the URBs to the current buffers
+static void usb_mouse_fill_urbs(struct usb_mouse *mouse)
+{
+    int n;
+
+    for (n = 0; n < mouse->num_urbs; n++) {
+        mouse->irq[n]->transfer_buffer = mouse->data[n];
+        mouse->irq[n]->transfer_buffer_length = mouse->buffer_size;
+        mouse->irq[n]->transfer_dma = mouse->data_dma[n];
+        mouse->irq[n]->transfer_flags |= URB_NO_TRANSFER_DMA_MAP;
+    }
+}
+
+//One-shot reallocation after an EOVERFLOW: Doubles the buffers and resubmits all URBs
+static void usb_mouse_grow(struct work_struct *work)
+{
+    struct usb_mouse *mouse = container_of(work, struct usb_mouse, grow_work);
+    signed char *data[MAX_URBS] = { NULL };
+    dma_addr_t data_dma[MAX_URBS];
+    int old_size = mouse->buffer_size;
+    int size = min_t(int, 2*old_size, HID_MAX_BUFFER_SIZE);
+
+    mutex_lock(&mouse->lock);
+    WRITE_ONCE(mouse->grown, true);
+    usb_mouse_kill_urbs(mouse);
+
+    //Allocate the new buffers aside first, so the old ones stay in use, if that fails
+    if (usb_mouse_alloc_buffers(mouse->usbdev, size, mouse->num_urbs, data, data_dma)) {
+        usb_mouse_free_buffers(mouse->usbdev, size, data, data_dma);
+        dev_err(&mouse->usbdev->dev, "leetmouse: Cannot grow the report buffer beyond %d bytes\n", old_size);
+    } else {
+        usb_mouse_free_buffers(mouse->usbdev, old_size, mouse->data, mouse->data_dma);
+        memcpy(mouse->data, data, sizeof(mouse->data));
+        memcpy(mouse->data_dma, data_dma, sizeof(mouse->data_dma));
+        mouse->buffer_size = size;
+        usb_mouse_fill_urbs(mouse);
+        dev_info(&mouse->usbdev->dev, "leetmouse: Report buffer grown from %d to %d bytes\n", old_size, mouse->buffer_size);
+    }
+
+    if (mouse->open && usb_mouse_submit_urbs(mouse))
+        mouse->open = false;
+    mutex_unlock(&mouse->lock);
+}
+
+// sysfs attributes of the USB interface
+static ssize_t urb_queue_dry_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct usb_mouse *mouse = usb_get_intfdata(to_usb_interface(dev));
+
+    if (!mouse)
+        return -ENODEV;
+    return scnprintf(buf, PAGE_SIZE, "%lu\n", READ_ONCE(mouse->queue_dry));
+}
+static DEVICE_ATTR_RO(urb_queue_dry);
+
+//Reports, whose motion could not be accelerated right away (no FPU in the IRQ), and how many of them got emitted by the flush timer
+static ssize_t deferred_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct usb_mouse *mouse = usb_get_intfdata(to_usb_interface(dev));
+
+    if (!mouse)
+        return -ENODEV;
+    return scnprintf(buf, PAGE_SIZE, "%llu %llu\n",
+        stats_count(&mouse->report.stats, STATS_DEFERRED) + stats_count(&mouse->report.stats, STATS_FLOAT_TRAP),
+        stats_count(&mouse->report.stats, STATS_FLUSHED));
+}
+static DEVICE_ATTR_RO(deferred);
+
+//Polling interval override of this mouse in us. 0 falls back to the module parameter 'interval'. Applied right away
+static ssize_t interval_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct usb_mouse *mouse = usb_get_intfdata(to_usb_interface(dev));
+
+    if (!mouse)
+        return -ENODEV;
+    return scnprintf(buf, PAGE_SIZE, "%u\n", mouse->interval_us);
+}
+
+static ssize_t interval_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    struct usb_mouse *mouse = usb_get_intfdata(to_usb_interface(dev));
+    unsigned int us;
+    int ret;
+
+    if (!mouse)
+        return -ENODEV;
+    ret = kstrtouint(buf, 10, &us);
+    if (ret)
+        return ret;
+
+    mutex_lock(&mouse->lock);
+    mouse->interval_us = us;
+    if (mouse->open) {
+        usb_mouse_kill_urbs(mouse);
+        if (usb_mouse_submit_urbs(mouse)) {
+            mouse->open = false;
+            ret = -EIO;
+        }
+    }
+    mutex_unlock(&mouse->lock);
+
+    return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(interval);
+
+//Report rate in Hz: Measured from the completion timestamps while the mouse moves. Otherwise the rate of the period the endpoint is scheduled with,
+//which may differ from the requested interval (rounded to what bInterval can express)
+static ssize_t rate_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct usb_mouse *mouse = usb_get_intfdata(to_usb_interface(dev));
+    s64 period;
+
+    if (!mouse)
+        return -ENODEV;
+    period = READ_ONCE(mouse->period_ns);
+    if (!period)
+        period = (s64) usb_mouse_period_us(mouse) * NSEC_PER_USEC;
+    return scnprintf(buf, PAGE_SIZE, "%lld\n", div64_s64(NSEC_PER_SEC + period/2, period));
+}
+static DEVICE_ATTR_RO(rate);
+
+static struct attribute *usb_mouse_attrs[] = {
+    &dev_attr_urb_queue_dry.attr,
+    &dev_attr_deferred.attr,
+    &dev_attr_interval.attr,
+    &dev_attr_rate.attr,
+    NULL
+};
+
+static const struct attribute_group usb_mouse_attr_group = {
+    .attrs = usb_mouse_attrs,
+};
+                                                                //Leetmouse Mod END
+
 static int hid_get_class_descriptor(struct usb_device *dev, int ifnum,
         unsigned char type, void *buf, int size)
 {
@@ -192,9 +514,11 @@ static int usb_mouse_probe(struct usb_interface *intf, const struct usb_device_i
     if (!mouse || !input_dev)
         goto fail1;
     
-    mouse->data = usb_alloc_coherent(dev, BUFFER_SIZE, GFP_ATOMIC, &mouse->data_dma); //Leetmouse Mod
-    if (!mouse->data)
-        goto fail1;
+                                                                //Leetmouse Mod BEGIN
+    mouse->num_urbs = clamp_t(int, g_urbs, 1, MAX_URBS);
+    mutex_init(&mouse->lock);
+    INIT_WORK(&mouse->grow_work, usb_mouse_grow);
+                                                                //Leetmouse Mod END
 
                                                                 //Leetmouse Mod BEGIN
     if (usb_get_extra_descriptor(interface, HID_DT_HID, &hdesc) &&
@@ -252,12 +576,30 @@ static int usb_mouse_probe(struct usb_interface *intf, const struct usb_device_i
         goto fail1_5;
                                                                 //Leetmouse Mod END
 
-    mouse->irq = usb_alloc_urb(0, GFP_KERNEL);
-    if (!mouse->irq)
-        goto fail2;
+                                                                //Leetmouse Mod BEGIN
+    //The buffers hold a full packet as well as the largest report of the descriptor
+    mouse->buffer_size = max3(maxp, (int) rpos->report_len, BUFFER_SIZE);
+    mouse->buffer_size = min_t(int, mouse->buffer_size, HID_MAX_BUFFER_SIZE);
+    ret = usb_mouse_alloc_buffers(dev, mouse->buffer_size, mouse->num_urbs, mouse->data, mouse->data_dma);
+    if (ret)
+        goto fail1_5;
+
+    ret = -ENOMEM;
+    for (n = 0; n < mouse->num_urbs; n++) {
+        mouse->irq[n] = usb_alloc_urb(0, GFP_KERNEL);
+        if (!mouse->irq[n])
+            goto fail1_5;
+    }
+    atomic_set(&mouse->in_flight, 0);
+                                                                //Leetmouse Mod END
 
     mouse->usbdev = dev;
     mouse->dev = input_dev;
+                                                                //Leetmouse Mod BEGIN
+    ret = report_init(&mouse->report, input_dev, &intf->dev);
+    if (ret)
+        goto fail1_5;
+                                                                //Leetmouse Mod END
 
     if (dev->manufacturer)
         strlcpy(mouse->name, dev->manufacturer, sizeof(mouse->name));
@@ -282,39 +624,45 @@ static int usb_mouse_probe(struct usb_interface *intf, const struct usb_device_i
     usb_to_input_id(dev, &input_dev->id);
     input_dev->dev.parent = &intf->dev;
 
-    input_dev->evbit[0] = BIT_MASK(EV_KEY) | BIT_MASK(EV_REL);
-    input_dev->keybit[BIT_WORD(BTN_MOUSE)] = BIT_MASK(BTN_LEFT) |
-        BIT_MASK(BTN_RIGHT) | BIT_MASK(BTN_MIDDLE);
-    input_dev->relbit[0] = BIT_MASK(REL_X) | BIT_MASK(REL_Y);
-    input_dev->keybit[BIT_WORD(BTN_MOUSE)] |= BIT_MASK(BTN_SIDE) |
-        BIT_MASK(BTN_EXTRA);
-    input_dev->relbit[0] |= BIT_MASK(REL_WHEEL);
+    report_capabilities(input_dev);                             //Leetmouse Mod
 
     input_set_drvdata(input_dev, mouse);
 
     input_dev->open = usb_mouse_open;
     input_dev->close = usb_mouse_close;
 
-    usb_fill_int_urb(mouse->irq, dev, pipe, mouse->data,
-             (maxp > BUFFER_SIZE ? BUFFER_SIZE : maxp),         //Leetmouse Mod
-             usb_mouse_irq, mouse, endpoint->bInterval);
-    mouse->irq->transfer_dma = mouse->data_dma;
-    mouse->irq->transfer_flags |= URB_NO_TRANSFER_DMA_MAP;
-
-    ret = input_register_device(mouse->dev);                    //Leetmouse Mod
-    if (ret)                                                    //Leetmouse Mod
-        goto fail3;
+                                                                //Leetmouse Mod BEGIN
+    for (n = 0; n < mouse->num_urbs; n++)
+        usb_fill_int_urb(mouse->irq[n], dev, pipe, mouse->data[n], mouse->buffer_size,
+                 usb_mouse_irq, mouse, endpoint->bInterval);
+    usb_mouse_fill_urbs(mouse);
+    mouse->ep = &interface->endpoint[0];
+    mouse->default_binterval = endpoint->bInterval;
+    mouse->ifnum = interface->desc.bInterfaceNumber;
+
+    ret = input_register_device(mouse->dev);
+    if (ret)
+        goto fail_report;
 
     usb_set_intfdata(intf, mouse);
+
+    ret = sysfs_create_group(&intf->dev.kobj, &usb_mouse_attr_group);
+    if (ret) {
+        usb_set_intfdata(intf, NULL);
+        input_unregister_device(input_dev);
+        input_dev = NULL;                                       // Freed by input_unregister_device
+        goto fail_report;
+    }
     return 0;
 
-fail3:    
-    usb_free_urb(mouse->irq);
-fail2:    
-    usb_free_coherent(dev, BUFFER_SIZE, mouse->data, mouse->data_dma); //Leetmouse Mod
+fail_report:
+    report_exit(&mouse->report);
 fail1_5:
     kfree(mouse->data_pos);
-fail1:    
+fail1:
+    if (mouse)
+        usb_mouse_free_urbs(dev, mouse);
+                                                                //Leetmouse Mod END
     input_free_device(input_dev);
     kfree(mouse);
     return ret;                                                 //Leetmouse Mod
@@ -324,13 +672,17 @@ static void usb_mouse_disconnect(struct usb_interface *intf)
 {
     struct usb_mouse *mouse = usb_get_intfdata (intf);
 
+    if (mouse)                                                  //Leetmouse Mod
+        sysfs_remove_group(&intf->dev.kobj, &usb_mouse_attr_group); //Leetmouse Mod
     usb_set_intfdata(intf, NULL);
     if (mouse) {
-        usb_kill_urb(mouse->irq);
-        input_unregister_device(mouse->dev);
-        usb_free_urb(mouse->irq);
                                                                 //Leetmouse Mod BEGIN
-        usb_free_coherent(interface_to_usbdev(intf), BUFFER_SIZE, mouse->data, mouse->data_dma);
+        usb_mouse_close(mouse->dev);
+        cancel_work_sync(&mouse->grow_work);                    // Does not resubmit anything after the close
+        usb_mouse_set_binterval(mouse, mouse->default_binterval);   // The next driver gets the interval of the mouse
+        input_unregister_device(mouse->dev);
+        report_exit(&mouse->report);
+        usb_mouse_free_urbs(interface_to_usbdev(intf), mouse);
         kfree(mouse->data_pos);
                                                                 //Leetmouse Mod END
         kfree(mouse);
@@ -352,4 +704,93 @@ static struct usb_driver usb_mouse_driver = {
     .id_table    = usb_mouse_id_table,
 };
 
-module_usb_driver(usb_mouse_driver);
+                                                                //Leetmouse Mod BEGIN
+//Points of the custom curve (AccelerationMode 4) as (speed, sensitivity) pairs of floats: /sys/module/leetmouse/CurvePoints
+//The whole table has to be written at once. See accel_set_curve()
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,13,0)
+#define LEET_BIN_ATTR const struct bin_attribute
+#else
+#define LEET_BIN_ATTR struct bin_attribute
+#endif
+
+static ssize_t CurvePoints_read(struct file *filp, struct kobject *kobj, LEET_BIN_ATTR *attr, char *buf, loff_t off, size_t count)
+{
+    void *points;
+    size_t len;
+    ssize_t ret;
+
+    points = kmalloc(CURVE_POINTS * 2 * sizeof(float), GFP_KERNEL);
+    if (!points)
+        return -ENOMEM;
+    len = accel_get_curve(points, CURVE_POINTS * 2 * sizeof(float));
+    ret = memory_read_from_buffer(buf, count, &off, points, len);
+    kfree(points);
+    return ret;
+}
+
+static ssize_t CurvePoints_write(struct file *filp, struct kobject *kobj, LEET_BIN_ATTR *attr, char *buf, loff_t off, size_t count)
+{
+    int ret;
+
+    if (off)
+        return -EINVAL;
+    ret = accel_set_curve(buf, count);
+    return ret ? ret : count;
+}
+
+static BIN_ATTR_RW(CurvePoints, CURVE_POINTS * 2 * sizeof(float));
+
+static int __init usb_mouse_init(void)
+{
+    int ret;
+
+    stats_init();
+    ret = accel_init();
+    if (ret)
+        goto fail_accel;
+
+    ret = sysfs_create_bin_file(&THIS_MODULE->mkobj.kobj, &bin_attr_CurvePoints);
+    if (ret)
+        goto fail_curve;
+
+    ret = usb_register(&usb_mouse_driver);
+    if (ret)
+        goto fail_usb;
+
+    //Second backend: Any HID transport (USB, Bluetooth, I2C, uhid) via hid-core. See hidmouse.c
+    ret = hid_mouse_register();
+    if (ret)
+        goto fail_hid;
+
+    //Virtual mice for testing without hardware. See inject.c
+    ret = inject_register();
+    if (ret)
+        goto fail_inject;
+    return 0;
+
+fail_inject:
+    hid_mouse_unregister();
+fail_hid:
+    usb_deregister(&usb_mouse_driver);
+fail_usb:
+    sysfs_remove_bin_file(&THIS_MODULE->mkobj.kobj, &bin_attr_CurvePoints);
+fail_curve:
+    accel_exit();
+fail_accel:
+    stats_exit();
+    return ret;
+}
+
+static void __exit usb_mouse_exit(void)
+{
+    inject_unregister();
+    hid_mouse_unregister();
+    usb_deregister(&usb_mouse_driver);
+    sysfs_remove_bin_file(&THIS_MODULE->mkobj.kobj, &bin_attr_CurvePoints);
+    accel_exit();
+    stats_exit();
+}
+
+module_init(usb_mouse_init);
+module_exit(usb_mouse_exit);
+                                                                //Leetmouse Mod END
@@ -7,8 +7,35 @@
 // ########## Kernel module parameters
 // Debug parameters
 #include <linux/module.h>
-static char g_debug = 0;
-module_param_named(debug, g_debug, byte, 0644);
+#include <linux/moduleparam.h>
+DEFINE_STATIC_KEY_FALSE(leetmouse_debug);
+
+// The static key gets patched on writes, so nobody has to check a variable on every report
+static int param_set_debug(const char *val, const struct kernel_param *kp)
+{
+    u8 on;
+    int ret = kstrtou8(val, 0, &on);
+
+    if(ret)
+        return ret;
+    if(on)
+        static_branch_enable(&leetmouse_debug);
+    else
+        static_branch_disable(&leetmouse_debug);
+    return 0;
+}
+
+static int param_get_debug(char *buffer, const struct kernel_param *kp)
+{
+    return scnprintf(buffer, PAGE_SIZE, "%d\n", static_key_enabled(&leetmouse_debug) ? 1 : 0);
+}
+
+static const struct kernel_param_ops param_ops_debug = {
+    .set = param_set_debug,
+    .get = param_get_debug,
+};
+module_param_cb(debug, &param_ops_debug, NULL, 0644);
+MODULE_PARM_DESC(debug, "Logs the parsed report descriptors and the raw reports (see debugfs: leetmouse/<device>/log)");
 
 //This is the most crudest HID descriptor parser EVER.
 //We will skip most control words until we found an interesting one
@@ -34,6 +61,38 @@ struct parser_context {
     entry.size = _size;                             \
     entry.sgn = _sign;
 
+//Compiles the extraction plan of an entry from its bit offset, bit size and sign, so extract_at() boils down to a few loads and shifts
+static void compile_entry(struct report_entry *entry)
+{
+    unsigned int bytes = (entry->offset % 8 + entry->size + 7) / 8;    //Number of bytes touched by the field
+
+    entry->index = entry->offset / 8;
+    entry->end = entry->index + bytes;
+    entry->shift = entry->offset % 8;
+    entry->mask = 0;
+    entry->sign = 0;
+
+    //Same limits as always: Nothing beyond 16 bits. Also never read more than 4 bytes
+    if(!entry->size || entry->size > 16 || bytes > 4){
+        entry->type = EXTRACT_NONE;
+        return;
+    }
+
+    if(!entry->shift && entry->size == 8){
+        entry->type = entry->sgn ? EXTRACT_S8 : EXTRACT_U8;
+        return;
+    }
+    if(!entry->shift && entry->size == 16){
+        entry->type = entry->sgn ? EXTRACT_S16 : EXTRACT_U16;
+        return;
+    }
+
+    entry->type = EXTRACT_BITS;
+    entry->mask = 0xFFFFFFFFu >> (32 - entry->size);
+    if(entry->sgn)
+        entry->sign = 1u << (entry->size - 1);
+}
+
 int parse_report_desc(unsigned char *buffer, int buffer_len, struct report_positions *pos)
 {
     int r_count = 0, r_size = 0, r_sgn = 0, len = 0;
@@ -53,6 +112,10 @@ int parse_report_desc(unsigned char *buffer, int buffer_len, struct report_posit
     }
     
     pos->report_id_tagged = 0;
+    memset(&pos->button, 0, sizeof(pos->button));
+    memset(&pos->x, 0, sizeof(pos->x));
+    memset(&pos->y, 0, sizeof(pos->y));
+    memset(&pos->wheel, 0, sizeof(pos->wheel));
 
     //Initialize contexts to zero
     for(n = 0; n < NUM_CONTEXTS; n++){
@@ -63,7 +126,12 @@ int parse_report_desc(unsigned char *buffer, int buffer_len, struct report_posit
     while(i < buffer_len){
         ctl = buffer[i] & 0xFC;                     // Control word with the length-bits stripped
         len = buffer[i] & 0x03;                     // Length of the the proceeding data, following the control word (in bytes)
-        if(i < buffer_len) data = buffer + i + 1;   // Beginning of data after the control word
+        if(len == 3) len = 4;                       // The size code 3 stands for 4 bytes
+        data = buffer + i + 1;                      // Beginning of data after the control word
+
+        //Descriptors can come from userspace (inject, uhid): A truncated item must not make us read beyond the buffer
+        if(i + 1 + len > (unsigned int) buffer_len)
+            return -EINVAL;
 
         // ######## Global items
         //Determine the size
@@ -162,123 +230,89 @@ int parse_report_desc(unsigned char *buffer, int buffer_len, struct report_posit
         }
         i += len + 1;
     }
+
+    //Largest report. Unused contexts have an offset of 0
+    pos->report_len = 0;
+    for(n = 0; n < NUM_CONTEXTS; n++){
+        if((contexts[n].offset + 7) / 8 > pos->report_len)
+            pos->report_len = (contexts[n].offset + 7) / 8;
+    }
     
-    if(g_debug){
+    if(static_branch_unlikely(&leetmouse_debug)){
         printk("BTN\t(%d): Offset %u\tSize %u\t Sign %u",   pos->button.id ,    (unsigned int) pos->button.offset,  pos->button.size,   pos->button.sgn);
         printk("X\t(%d): Offset %u\tSize %u\t Sign %u",     pos->x.id,          (unsigned int) pos->x.offset,       pos->x.size,        pos->x.sgn);
         printk("Y\t(%d): Offset %u\tSize %u\t Sign %u",     pos->x.id,          (unsigned int) pos->y.offset,       pos->y.size,        pos->x.sgn);
         printk("WHL\t(%d): Offset %u\tSize %u\t Sign %u",   pos->wheel.id,      (unsigned int) pos->wheel.offset,   pos->wheel.size,    pos->wheel.sgn);
     }
 
-    return 0;
-}
+    compile_entry(&pos->button);
+    compile_entry(&pos->x);
+    compile_entry(&pos->y);
+    compile_entry(&pos->wheel);
 
-//Shifts an array *data of length data_len (in bytes) by amounts of num in bits to the right/left, depending on right = 1/0 (maximum bits to shift: 8)
-//This shift method is assuming little-endian data, as it is dictated by the HID standard.
-//So taking a byte as [MSB, ..., LSB], then e.g. a 2 byte long array "[7,8,6,5,4,3,2,1,0], [15,14,13,12,11,10,9] << 2" (left = 1, num = 2) becomes "[5,4,3,2,1,0,_,_], [13,12,11,10,9,8,7,6]"
-//Most certainly not the most elegant and fastest way to do this. However, it works. (Limiting this to only 4-byte long data, one could use a preprocessor define, which is way faster but bound to that type).
-inline void array_shift_le(unsigned char *data, int data_len, bool right, int num){
-    int i;
-    if(num == 0) return;
-
-    //Right shift
-    if(right){
-        for(i = 0; i < data_len; i++){
-            data[i] >>= num;
-            if(i + 1 < data_len){
-                data[i] |= data[i+1] << (8 - num);
-            }
-        }
-    //Left shift
-    } else {
-        for(i = data_len - 1; i >= 0; i--){
-            data[i] <<= num;
-            if(i){
-                data[i] |= data[i-1] >> (8 - num);
-            }
-        }
-    }
+    //Report ID dispatch table
+    memset(pos->fields, 0, sizeof(pos->fields));
+    if(pos->button.type != EXTRACT_NONE) pos->fields[pos->button.id] |= FIELD_BUTTON;
+    if(pos->x.type != EXTRACT_NONE)      pos->fields[pos->x.id]      |= FIELD_X;
+    if(pos->y.type != EXTRACT_NONE)      pos->fields[pos->y.id]      |= FIELD_Y;
+    if(pos->wheel.type != EXTRACT_NONE)  pos->fields[pos->wheel.id]  |= FIELD_WHEEL;
+
+    return 0;
 }
 
-//Extracts a number from a raw USB stream, according to its bit-position and bit-size as stated in the report_entry
-inline int extract_at(unsigned char *data, int data_len, struct report_entry *entry)
+//Extracts a number from a raw USB stream, according to the extraction plan of the report_entry (see compile_entry)
+//All data is little-endian, as dictated by the HID standard
+static INLINE int extract_at(unsigned char *data, int data_len, struct report_entry *entry)
 {
-    int size = entry->size/8;           //Size of our data in bytes
-    int i = entry->offset/8;            //Starting index of data[] to access in byte-aligned size
-    char shift = entry->offset % 8;     //Remaining bits to shift left, until we reach our target data
-    union {
-        __u8 raw[4];    //Raw buffer of individual bytes. Must be of same length as "init" and at least 2 bytes bigger than the biggest datatype you want to handle in here
-        __u32 init;     //Continous buffer of aboves bytes (used for initialization)
-        __s8 s8;        //Return value
-        __s16 s16;      //Return value
-        __u8 u8;        //Return value
-        __u16 u16;      //Return value
-    } buffer;
-
-    //Data structure to read is bigger than a clear multiple of 8 bits. Read one more byte.
-    if(entry->size % 8) size += 1;
-    //The bit position is not aligned with byte-size. Read one more byte to make sure, we catch all necessary bits
-    if(shift) size += 1;
-    //Data structure to read is bigger than we can handle. Abort
-    if(size > sizeof(buffer.init)) return 0;
-
-    buffer.init = 0; //Initialized buffer to zero
-
-    //Avoid access violation when using memcpy.
-    if(i + size > data_len) return 0;
-
-    //Create a local copy, that we can modify.
-    memcpy(buffer.raw, data + i, size);
-
-    //NOTE: All data manipulation below is only valid for little-endian data. The HID standard however dictates little-endian, so this is fine. However, we need to transform to machine data in the end for multi-byte types
-    if(shift)
-        array_shift_le(buffer.raw,size,true,shift);         //Align bits to memory
-
-    if(entry->size <= 8){
-        buffer.raw[0] &= 0xFF >> (8 - entry->size);         //Zero MSB bits, if entry->size < 8
-        if(entry->sgn)                                      //If the initial value was signed and if it was not exactly of size 8, we need to add the missing sign-bits, which have been masked above with zeros.
-            buffer.raw[0] = buffer.raw[0] >> (8 - entry->size - 1) == 0 ? buffer.raw[0] : (0xFF ^ (0xFF >> (8 - entry->size))) | buffer.raw[0];
-        
-        return (int) (entry->sgn ? buffer.s8 : buffer.u8);
-    }
-    if(entry->size <= 16){
-        buffer.raw[1] &= 0xFF >> (16 - entry->size);        //Zero MSB bits, if entry->size < 16
-        if(entry->sgn)                                      //If the initial value was signed and if it was not exactly of size 16, we need to add the missing sign-bits, which have been masked above with zeros.
-            buffer.raw[1] = buffer.raw[1] >> (16 - entry->size - 1) == 0 ? buffer.raw[1] : (0xFF ^ (0xFF >> (16 - entry->size))) | buffer.raw[1];
-
-        buffer.u16 = le16_to_cpu(buffer.u16);               //Convert to machine units
-        return (int) (entry->sgn ? buffer.s16 : buffer.u16);
+    unsigned char *d = data + entry->index;
+    unsigned int v;
+
+    //Avoid access violation: Every byte from the first (index) to the last (end - 1) of the field has to be within the report
+    if(entry->end > data_len) return 0;
+
+    switch(entry->type){
+    case EXTRACT_U8:
+        return d[0];
+    case EXTRACT_S8:
+        return (__s8) d[0];
+    case EXTRACT_U16:
+        return (__u16) (d[0] | d[1] << 8);
+    case EXTRACT_S16:
+        return (__s16) (d[0] | d[1] << 8);
+    case EXTRACT_BITS:
+        v = d[0];
+        switch(entry->end - entry->index){
+        case 4: v |= (unsigned int) d[3] << 24;     /* fall through */
+        case 3: v |= (unsigned int) d[2] << 16;     /* fall through */
+        case 2: v |= (unsigned int) d[1] << 8;
+        }
+        v = (v >> entry->shift) & entry->mask;
+        return (int) (v ^ entry->sign) - (int) entry->sign;    //Sign extension. A no-op for unsigned fields, since sign is 0 then
+    default:
+        return 0;
     }
-
-    return 0; //All other lengths are not supported.
 }
 
 // Extracts the interesting mouse data from the raw USB data, according to the layout delcared in the report descriptor
+// Returns the fields (enum report_field) carried by this report. Reports without any (e.g. vendor reports) return 0 and can be dropped before any further work
 int extract_mouse_events(unsigned char *buffer, int buffer_len, struct report_positions *pos, int *btn, int *x, int *y, int *wheel)
 {
-    unsigned char id = 0;
-
-    if(g_debug){
-        int i;
-        printk(KERN_CONT "Raw: ");
-        for(i = 0; i<buffer_len;i++){
-            printk(KERN_CONT "0x%02x ", (int) buffer[i]);
-        }
-        printk(KERN_CONT "\n");
-    }
+    unsigned char id = 0, fields;
 
+    //Empty reports carry neither a report ID nor a field
+    if(buffer_len < 1)
+        return 0;
     if(pos->report_id_tagged)
         id = buffer[0];
 
-    *btn = 0; *x = 0; *y = 0; *wheel = 0;
-    if(pos->button.id == id)
-        *btn =      extract_at(buffer, buffer_len, &pos->button);
-    if(pos->x.id == id)
-        *x =        extract_at(buffer, buffer_len, &pos->x);
-    if(pos->y.id == id)
-        *y =        extract_at(buffer, buffer_len, &pos->y);
-    if(pos->wheel.id == id)
-        *wheel =    extract_at(buffer, buffer_len, &pos->wheel);
+    fields = pos->fields[id];
+    if(!fields)
+        return 0;
 
-    return 0;
+    *btn =      fields & FIELD_BUTTON ? extract_at(buffer, buffer_len, &pos->button) : 0;
+    *x =        fields & FIELD_X      ? extract_at(buffer, buffer_len, &pos->x)      : 0;
+    *y =        fields & FIELD_Y      ? extract_at(buffer, buffer_len, &pos->y)      : 0;
+    *wheel =    fields & FIELD_WHEEL  ? extract_at(buffer, buffer_len, &pos->wheel)  : 0;
+
+    return fields;
 }
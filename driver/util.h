@@ -1,8 +1,13 @@
 #ifndef _UTIL_H
 #define _UTIL_H
 
+#include <linux/jump_label.h>
+
 #define INLINE __attribute__((always_inline)) inline
 
+// Module parameter 'debug'. A static key, so the debug paths cost nothing but a NOP while it is off
+DECLARE_STATIC_KEY_FALSE(leetmouse_debug);
+
 // HID Descriptors
 enum D_hid_descriptor{
     // No data follows after descriptor
@@ -27,12 +32,38 @@ enum hid_data{
     D_USAGE_Y = 0x31
 };
 
+// How a report_entry is extracted from the raw data. Chosen once by parse_report_desc, so extract_mouse_events does not need to look at the layout again
+enum extract_type {
+    EXTRACT_NONE = 0,       // Not present or unsupported layout. Always yields 0
+    EXTRACT_U8,             // Byte aligned 8 bit fields: A single load
+    EXTRACT_S8,
+    EXTRACT_U16,            // Byte aligned 16 bit fields: A single (little-endian) load
+    EXTRACT_S16,
+    EXTRACT_BITS            // Everything else (e.g. 12 bit fields or buttons): Load, shift, mask and sign-extend
+};
+
 //Stores the bit offset, bit size, sign and associated report ID of an entry for extracting the value from the raw usb_mouse->data buffer
+//The second half is the extraction plan compiled from the first half
 struct report_entry {
     unsigned char id;       // Report ID
 	unsigned char offset;	// In bits
 	unsigned char size;		// In bits
     unsigned char sgn;      // Is this value signed (1) or unsigned (0)?
+
+    unsigned char type;     // enum extract_type
+    unsigned char index;    // First byte of the field in the raw data
+    unsigned char end;      // One past the last byte of the field. Reports shorter than this yield 0
+    unsigned char shift;    // Right shift to align the field to bit 0 (EXTRACT_BITS only)
+    unsigned int mask;      // Mask of the field after the shift (EXTRACT_BITS only)
+    unsigned int sign;      // Sign bit of the field after the shift, 0 if unsigned (EXTRACT_BITS only)
+};
+
+// Bits of report_positions.fields
+enum report_field {
+    FIELD_BUTTON = 0x01,
+    FIELD_X = 0x02,
+    FIELD_Y = 0x04,
+    FIELD_WHEEL = 0x08
 };
 
 //Stores a collection of important offsets & sizes etc for the received raw data in the usb_mouse->data buffer
@@ -42,6 +73,8 @@ struct report_positions {
 	struct report_entry x;
 	struct report_entry y;
 	struct report_entry wheel;
+    unsigned char fields[256];  //Report ID -> Fields (enum report_field) carried by reports of this ID. Untagged reports use ID 0
+    unsigned int report_len;    //Length of the largest report in bytes, including the report ID
 };
 
 int parse_report_desc(unsigned char *data, int data_len, struct report_positions *data_pos);